@@ -0,0 +1,193 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "checksum.h"
+
+/* CRC32C polynomial (reversed) */
+#define CRC32C_POLY 0x82f63b78
+
+/* tables for slicing-by-8, filled in on first use */
+static uint32_t crc32c_table[8][256];
+static int crc32c_table_ready = 0;
+
+static void
+crc32c_init_table(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+
+		crc32c_table[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++) {
+		crc = crc32c_table[0][i];
+		for (j = 1; j < 8; j++) {
+			crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+			crc32c_table[j][i] = crc;
+		}
+	}
+
+	crc32c_table_ready = 1;
+}
+
+static uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t size)
+{
+	uint64_t word;
+
+	if (!crc32c_table_ready)
+		crc32c_init_table();
+
+	/* align to 8 bytes */
+	while (size > 0 && ((uintptr_t) p & 7)) {
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		size--;
+	}
+
+	/* slicing-by-8 (little endian) */
+	while (size >= 8) {
+		memcpy(&word, p, sizeof word);
+		word ^= crc;
+
+		crc = crc32c_table[7][word & 0xff] ^
+		      crc32c_table[6][(word >> 8) & 0xff] ^
+		      crc32c_table[5][(word >> 16) & 0xff] ^
+		      crc32c_table[4][(word >> 24) & 0xff] ^
+		      crc32c_table[3][(word >> 32) & 0xff] ^
+		      crc32c_table[2][(word >> 40) & 0xff] ^
+		      crc32c_table[1][(word >> 48) & 0xff] ^
+		      crc32c_table[0][word >> 56];
+
+		p += 8;
+		size -= 8;
+	}
+
+	while (size > 0) {
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		size--;
+	}
+
+	return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+
+#define HAVE_CRC32C_HW 1
+
+/* crc32 instruction, 8 bytes at once */
+__attribute__ ((target ("sse4.2"))) static uint32_t
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t size)
+{
+	uint64_t crc64, word;
+
+	while (size > 0 && ((uintptr_t) p & 7)) {
+		crc = _mm_crc32_u8(crc, *p++);
+		size--;
+	}
+
+	crc64 = crc;
+	while (size >= 8) {
+		memcpy(&word, p, sizeof word);
+		crc64 = _mm_crc32_u64(crc64, word);
+
+		p += 8;
+		size -= 8;
+	}
+	crc = (uint32_t) crc64;
+
+	while (size > 0) {
+		crc = _mm_crc32_u8(crc, *p++);
+		size--;
+	}
+
+	return crc;
+}
+#endif /* __x86_64__ && __GNUC__ */
+
+uint32_t
+wit_crc32c(uint32_t crc, const void *data, size_t size)
+{
+	assertf(data || size == 0, "No data to checksum");
+
+	crc = ~crc;
+
+#ifdef HAVE_CRC32C_HW
+	if (__builtin_cpu_supports("sse4.2"))
+		crc = crc32c_hw(crc, data, size);
+	else
+#endif
+		crc = crc32c_sw(crc, data, size);
+
+	return ~crc;
+}
+
+static int
+shm_format_bpp(uint32_t format)
+{
+	switch (format) {
+		case WL_SHM_FORMAT_ARGB8888:
+		case WL_SHM_FORMAT_XRGB8888:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+uint32_t
+wit_shm_checksum(const void *data, int32_t width, int32_t height,
+		 int32_t stride, uint32_t format)
+{
+	const unsigned char *row = data;
+	size_t row_size = stride;
+	uint32_t crc = 0;
+	int32_t y;
+
+	assertf(data, "No data to checksum");
+	assertf(width >= 0 && height >= 0 && stride >= 0,
+		"Wrong dimensions of buffer (%dx%d, stride %d)",
+		width, height, stride);
+
+	if (shm_format_bpp(format) > 0
+	    && (size_t) width * shm_format_bpp(format) < row_size)
+		row_size = (size_t) width * shm_format_bpp(format);
+
+	/* no padding, we can do it at once */
+	if (row_size == (size_t) stride)
+		return wit_crc32c(0, data, (size_t) stride * height);
+
+	for (y = 0; y < height; y++) {
+		crc = wit_crc32c(crc, row, row_size);
+		row += stride;
+	}
+
+	return crc;
+}
@@ -0,0 +1,44 @@
+#ifndef __WIT_CHECKSUM_H__
+#define __WIT_CHECKSUM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compute CRC32C (Castagnoli) of memory
+ *
+ * Uses the crc32 instruction when the CPU has SSE4.2, table-driven
+ * code otherwise. Both ways give the same result, so the checksum can
+ * be computed on one side and checked on the other one.
+ *
+ * To checksum discontiguous memory, pass the result of previous call
+ * as crc (start with 0).
+ *
+ * @param crc    checksum of preceding data (0 for the first chunk)
+ * @param data   memory to be checksummed
+ * @param size   size of the memory
+ * @return       checksum
+ */
+uint32_t
+wit_crc32c(uint32_t crc, const void *data, size_t size);
+
+/**
+ * Compute checksum of shm buffer contents
+ *
+ * Only visible pixels are checksummed (padding at the end of rows is
+ * skipped), so client and display get the same checksum even when
+ * the padding contains garbage. For formats with unknown pixel size
+ * whole rows (stride) are used.
+ *
+ * @param data    pixels
+ * @param width   width of buffer in pixels
+ * @param height  height of buffer in pixels
+ * @param stride  length of one row in bytes
+ * @param format  enum wl_shm_format
+ * @return        checksum
+ */
+uint32_t
+wit_shm_checksum(const void *data, int32_t width, int32_t height,
+		 int32_t stride, uint32_t format);
+
+#endif /* __WIT_CHECKSUM_H__ */
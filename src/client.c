@@ -144,13 +144,14 @@ wit_client_add_listener(struct wit_client *cl, const char *interface,
 	}
 }
 
-struct wit_client *
-wit_client_populate(int sock)
+static struct wit_client *
+client_populate(int sock, int batch_bind)
 {
 	struct wit_client *c = calloc(1, sizeof *c);
 	assert(c && "Out of memory");
 
 	c->sock = sock;
+	c->batch_bind = batch_bind;
 
 	c->display = wl_display_connect(NULL);
 	assertf(c->display, "Couldn't connect to display");
@@ -160,7 +161,15 @@ wit_client_populate(int sock)
 	assertf(c->registry.proxy, "Couldn't get registry");
 
 	wit_client_add_listener(c, "wl_registry", &registry_default_listener);
-	wl_display_dispatch(c->display);
+
+	if (batch_bind) {
+		/* get all globals and bind them */
+		wl_display_roundtrip(c->display);
+		/* let display process binds */
+		wl_display_roundtrip(c->display);
+	} else {
+		wl_display_dispatch(c->display);
+	}
 
 	assertf(wl_display_get_error(c->display) == 0,
 		"An error in display occured");
@@ -168,6 +177,18 @@ wit_client_populate(int sock)
 	return c;
 }
 
+struct wit_client *
+wit_client_populate(int sock)
+{
+	return client_populate(sock, 0);
+}
+
+struct wit_client *
+wit_client_populate_batch(int sock)
+{
+	return client_populate(sock, 1);
+}
+
 static void
 client_object_destroy(struct wit_client_object *obj,
 			void (*proxy_dest_func)(struct wl_proxy *))
@@ -194,6 +215,9 @@ client_object_destroy(struct wit_client_object *obj,
 void
 wit_client_free(struct wit_client *c)
 {
+	struct wit_client_seat **s;
+	struct wl_proxy **p;
+
 	assertf(c, "Wrong pointer");
 
 	/* do everything what left */
@@ -208,6 +232,23 @@ wit_client_free(struct wit_client *c)
 	client_object_destroy(&c->touch, (void *) &wl_touch_destroy);
 	client_object_destroy(&c->registry, (void *) &wl_registry_destroy);
 
+	wl_array_for_each(s, &c->seats) {
+		if ((*s)->pointer)
+			wl_pointer_destroy((struct wl_pointer *) (*s)->pointer);
+		if ((*s)->keyboard)
+			wl_keyboard_destroy((struct wl_keyboard *) (*s)->keyboard);
+		if ((*s)->touch)
+			wl_touch_destroy((struct wl_touch *) (*s)->touch);
+
+		wl_seat_destroy((struct wl_seat *) (*s)->seat);
+		free(*s);
+	}
+	wl_array_release(&c->seats);
+
+	wl_array_for_each(p, &c->synthetic)
+		wl_proxy_destroy(*p);
+	wl_array_release(&c->synthetic);
+
 	wl_display_disconnect(c->display);
 	close(c->sock);
 
@@ -17,6 +17,18 @@ struct wit_client_object {
 	struct wit_event last_event;
 };
 
+/*
+ * Seat announced after the first one (with its devices)
+ */
+struct wit_client_seat {
+	struct wit_client *client;
+
+	struct wl_proxy *seat;
+	struct wl_proxy *pointer;
+	struct wl_proxy *keyboard;
+	struct wl_proxy *touch;
+};
+
 /**
  * Data (which can be) used by client.
  *
@@ -38,6 +50,19 @@ struct wit_client {
 	struct wit_client_object touch;
 	struct wit_client_object shm;
 
+	/* when display has more seats, the first one is in seat
+	 * (and its devices in pointer, keyboard and touch), the others
+	 * are here (struct wit_client_seat *). Devices of these seats get
+	 * the same listeners as devices of the first seat */
+	struct wl_array seats;
+
+	/* proxies of bound synthetic globals (struct wl_proxy *) */
+	struct wl_array synthetic;
+
+	/* default registry listener doesn't do roundtrip after each bind
+	 * (see wit_client_populate_batch()) */
+	int batch_bind;
+
 	int sock;
 
 	/* here we can store events if we need (no need to pass more arguments
@@ -95,6 +120,20 @@ wit_client_init(struct wit_client *c, int s);
 struct wit_client *
 wit_client_populate(int sock);
 
+/**
+ * Create and populate structure client with constant number of roundtrips
+ *
+ * Same as wit_client_populate(), but all globals are bound during one
+ * roundtrip instead of doing a roundtrip after binding each global.
+ * Devices of seat are created upon seat capabilities, so one more
+ * roundtrip is needed before display has their resources.
+ *
+ * @param sock  socket passed to client's main function
+ * @return      filled struct client
+ */
+struct wit_client *
+wit_client_populate_batch(int sock);
+
 /**
  * Free all allocated memory and destroy proxies.
  * Does a roundtrip before and check for errors before freeing
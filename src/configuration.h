@@ -24,11 +24,92 @@
  * 	globals = CONF_SEAT
  *      resources = CONF_ALL
  * 	options = 0
+ *	latency = {0}
+ *
+ * Latency can be used to simulate slow display. When ack_delay is set,
+ * display waits before acknowledging each request from client, flush_delay
+ * delays flushing of emitted events and max_event_rate limits how many events
+ * per second display emits. A random value from <0, jitter> is added to
+ * each delay. Display keeps running wayland's loop while it waits, so
+ * wayland requests from client are being processed.
+ *
+ * example:
+ *
+ * struct wit_config conf = {CONF_SEAT, CONF_ALL, 0};
+ * conf.latency.ack_delay = 10000; // 10 ms
+ * conf.latency.jitter = 2000; // + <0, 2> ms
+ * conf.latency.max_event_rate = 125; // one event each 8 ms
+ *
+ * With CONF_OPT_STRESS option display doesn't emit events from eventarray
+ * once, but floods the client with them (repeatedly) to find out how many
+ * events per second the client is able to read. Rate starts at
+ * stress.start_rate and is doubled every stress.step milliseconds until
+ * it reaches stress.max_rate or until the client gets disconnected.
+ * Result is stored in wit_display.stress (see wit_stress_report).
+ *
+ * Display can have more seats (seats.count, at most WIT_MAX_SEATS), each
+ * one with its own capabilities (seats.caps[i] is bitmap of CONF_POINTER,
+ * CONF_KEYBOARD and CONF_TOUCH, 0 means all of them). Seats are created
+ * only when CONF_SEAT is in globals and resources bitmap still applies
+ * to all of them. seats.count == 0 means one seat.
+ *
+ * With CONF_OPT_KEYMAP option display sends keymap (keyboard.keymap or
+ * wit_default_keymap when NULL), repeat info and modifiers to every
+ * keyboard created by client.
+ *
+ * With CONF_OPT_PROBE option display measures how long it takes from
+ * posting an event to dispatching it in client (see wit_probe). Client
+ * stamps the dispatching by calling wit_probe_dispatched() from listeners.
+ * Results are printed by wit_display_destroy().
+ *
+ * synthetic.count globals of wit_synthetic_interface are created in
+ * addition to the others (and regardless of globals bitmap). They can be
+ * used for measuring how long it takes to enumerate and bind globals.
  */
+#define WIT_MAX_SEATS 16
+
 struct wit_config {
 	uint32_t globals;	/* bitmap of globals */
 	uint32_t resources;	/* bitmap of resources */
 	uint32_t options;	/* versatile bitmap */
+
+	/* synthetic latency, times are in microseconds (0 = none) */
+	struct {
+		uint32_t ack_delay;
+		uint32_t flush_delay;
+		uint32_t jitter;
+		uint32_t max_event_rate;	/* events per second */
+		unsigned int seed;		/* seed for jitter */
+	} latency;
+
+	/* stress mode (CONF_OPT_STRESS), 0 = use default value */
+	struct {
+		uint32_t start_rate;	/* events per second (1000) */
+		uint32_t max_rate;	/* events per second (1024000) */
+		uint32_t step;		/* length of one step in ms (100) */
+	} stress;
+
+	/* keyboard (CONF_OPT_KEYMAP), 0 = use default value */
+	struct {
+		const char *keymap;	/* xkb keymap as string */
+		int32_t repeat_rate;	/* characters per second (25) */
+		int32_t repeat_delay;	/* ms (600) */
+	} keyboard;
+
+	struct {
+		uint32_t count;
+		uint32_t caps[WIT_MAX_SEATS];
+	} seats;
+
+	/* synthetic globals */
+	struct {
+		uint32_t count;
+	} synthetic;
+
+	/* latency probe (CONF_OPT_PROBE), 0 = use default value */
+	struct {
+		uint32_t size;		/* max number of events (65536) */
+	} probe;
 };
 
 enum {
@@ -44,4 +125,11 @@ enum {
 	CONF_ALL 	= ~((uint32_t) 0)
 };
 
+/* options */
+enum {
+	CONF_OPT_STRESS	= 1,
+	CONF_OPT_KEYMAP	= 1 << 1,
+	CONF_OPT_PROBE	= 1 << 2,
+};
+
 #endif /* __WIT_CONFIGURATION_H__ */
@@ -42,6 +42,13 @@ struct event {
 	/* we wouldn't need this one, but it's simpler than go through signature
 	 * again (when sending) */
 	int args_no;
+
+	/* index of seat that the event goes to */
+	uint32_t seat;
+
+	/* when to emit the event, relative to start of emitting (timed
+	 * eventarrays only) */
+	uint64_t time_us;
 };
 
 unsigned int
@@ -69,11 +76,22 @@ wit_eventarray_add_vl(struct wit_eventarray *ea, enum side side,
 			= event->interface->events[event->opcode].signature;
 	assert(signature);
 
+	if (ea->count == ea->size) {
+		ea->size = ea->size ? 2 * ea->size : EVENTARRAY_INITIAL_SIZE;
+		ea->events = realloc(ea->events, ea->size * sizeof *ea->events);
+		assert(ea->events && "Out of memory");
+	}
+
 	struct event *e = calloc(1, sizeof *e);
 	assert(e && "Out of memory");
 
 	/* copy event */
 	e->event = *event;
+	e->seat = ea->seat;
+
+	/* untimed event goes together with the previous one */
+	if (ea->count > 0)
+		e->time_us = ea->events[ea->count - 1]->time_us;
 
 	/* copy arguments */
 	while(signature[i]) {
@@ -177,6 +195,36 @@ wit_eventarray_add(struct wit_eventarray *ea, enum side side,
 	return stat;
 }
 
+unsigned int
+wit_eventarray_add_timed(struct wit_eventarray *ea, enum side side,
+			 uint64_t time_us, const struct wit_event *event, ...)
+{
+	va_list vl;
+	int stat;
+
+	assertf(ea, "wit_eventarray is NULL");
+	assertf(ea->count == 0 || ea->events[ea->count - 1]->time_us <= time_us,
+		"Timed events must be added in order of their time");
+
+	va_start(vl, event);
+	stat = wit_eventarray_add_vl(ea, side, event, vl);
+	va_end(vl);
+
+	ea->events[ea->count - 1]->time_us = time_us;
+	ea->timed = 1;
+
+	return stat;
+}
+
+uint64_t
+wit_eventarray_next_time(struct wit_eventarray *ea)
+{
+	assert(ea);
+	assertf(ea->index < ea->count, "No events left in eventarray");
+
+	return ea->events[ea->index]->time_us;
+}
+
 /* return pointer to the next type in the signature */
 /* (that means skip all non-type parts of signature */
 static const char *
@@ -249,16 +297,21 @@ wit_eventarray_emit_one(struct wit_display *d, struct wit_eventarray *ea)
 
 	struct wl_resource *resource = NULL;
 	struct event *e = ea->events[ea->index];
+	struct wit_seat *seat = NULL;
+
+	/* surface events don't go through seat */
+	if (e->event.interface != &wl_surface_interface)
+		seat = wit_display_get_seat(d, e->seat);
 
 	/* choose right resource */
 	if (e->event.interface == &wl_seat_interface)
-		resource = d->resources.seat;
+		resource = seat->resources.seat;
 	else if (e->event.interface == &wl_pointer_interface)
-		resource = d->resources.pointer;
+		resource = seat->resources.pointer;
 	else if (e->event.interface ==  &wl_keyboard_interface)
-		resource = d->resources.keyboard;
+		resource = seat->resources.keyboard;
 	else if (e->event.interface == &wl_touch_interface)
-		resource = d->resources.touch;
+		resource = seat->resources.touch;
 	else if (e->event.interface == &wl_surface_interface)
 		resource = wl_client_get_object(d->client, e->args[0].u);
 	else
@@ -270,6 +323,10 @@ wit_eventarray_emit_one(struct wit_display *d, struct wit_eventarray *ea)
 
 	/* for post_event_array, we need objects, not ids */
 	convert_ids_to_objects(d, e);
+
+	if (d->probe)
+		wit_probe_posted(d->probe, e->event.interface, e->event.opcode);
+
 	wl_resource_post_event_array(resource, e->event.opcode, e->args);
 	/* and for later use (comparing etc.) it's good to have id again */
 	convert_objects_to_ids(e);
@@ -582,6 +639,11 @@ wit_eventarray_recieve(struct wit_display *d)
 	/* skeleton */
 	assread(d->client_sock[1], ea, sizeof(struct wit_eventarray));
 
+	/* pointer to events is not valid in this process */
+	ea->size = ea->count;
+	ea->events = malloc(ea->size * sizeof *ea->events);
+	assert((ea->events || ea->size == 0) && "Out of memory");
+
 	for (i = 0; i < ea->count; i++) {
 		ea->events[i] = recieve_event(d);
 	}
@@ -627,6 +689,7 @@ wit_eventarray_free(struct wit_eventarray *ea)
 		free(ea->events[i]);
 	}
 
+	free(ea->events);
 	free(ea);
 }
 
@@ -638,3 +701,12 @@ wit_eventarray_create()
 
 	return ea;
 }
+
+void
+wit_eventarray_set_seat(struct wit_eventarray *ea, uint32_t seat)
+{
+	assert(ea);
+	assertf(seat < WIT_MAX_SEATS, "Seat index out of range (%u)", seat);
+
+	ea->seat = seat;
+}
@@ -8,7 +8,9 @@ struct wit_display;
 struct wit_client;
 
 #define MAX_ARGS_NO 15
-#define MAX_EVENTS 100
+
+/* eventarray starts with space for this many events and grows */
+#define EVENTARRAY_INITIAL_SIZE 64
 
 /**
  * Usage:
@@ -28,10 +30,18 @@ struct wit_event {
 
 struct event;
 struct wit_eventarray {
-	struct event *events[MAX_EVENTS];
+	struct event **events;
+	unsigned size;	/* allocated slots of events */
 
 	unsigned count;
 	unsigned index;
+
+	/* seat for newly added events (see wit_eventarray_set_seat()) */
+	uint32_t seat;
+
+	/* set when events have time of emission
+	 * (see wit_eventarray_add_timed()) */
+	int timed;
 };
 
 /* we use pointer in all functions, so create event as opaque structure
@@ -53,6 +63,15 @@ struct wit_eventarray {
 struct wit_eventarray *
 wit_eventarray_create();
 
+/**
+ * Set seat for events added from now on
+ *
+ * When emitted, events of seat, pointer, keyboard and touch go to
+ * resources of this seat (index into display's seats). Default is 0.
+ */
+void
+wit_eventarray_set_seat(struct wit_eventarray *ea, uint32_t seat);
+
 /*
  * side = {CLIENT|DISPLAY}
  */
@@ -60,6 +79,26 @@ unsigned int
 wit_eventarray_add(struct wit_eventarray *ea, enum side side,
 			const struct wit_event *event, ...);
 
+/**
+ * Add event that should be emitted at given time
+ *
+ * Time is relative to the moment when client asked for events.
+ * Display acknowledges the request right away and emits timed events
+ * from its loop when their time comes, so the client can dispatch them
+ * meanwhile. Events added by wit_eventarray_add() into timed eventarray
+ * are emitted right after the previous event.
+ *
+ * @param time_us  time of emission in microseconds (events must be added
+ *                 in order of their time)
+ */
+unsigned int
+wit_eventarray_add_timed(struct wit_eventarray *ea, enum side side,
+			 uint64_t time_us, const struct wit_event *event, ...);
+
+/* time of the next event to be emitted (timed eventarrays) */
+uint64_t
+wit_eventarray_next_time(struct wit_eventarray *ea);
+
 unsigned int
 wit_eventarray_add_vl(struct wit_eventarray *ea, enum side side,
 		   const struct wit_event *event, va_list vl);
@@ -0,0 +1,189 @@
+#ifndef __WIT_GENERATOR_H__
+#define __WIT_GENERATOR_H__
+
+#include <stdint.h>
+
+struct wit_display;
+
+/**
+ * Generator of events
+ *
+ * Generators produce events on the fly, so they can feed display's
+ * emission path (see wit_display_add_generator()) without building
+ * eventarray first. One call of emit_one() emits one step of generated
+ * stream (e.g. pointer motion together with the frame event).
+ *
+ * Display paces the steps so that there are rate steps per second
+ * (rate == 0 means as fast as possible). Generated input events go
+ * to devices of given seat, set the seat after creating generator.
+ */
+struct wit_generator {
+	/* emit next step, return how many steps left */
+	int (*emit_one)(struct wit_generator *g, struct wit_display *d);
+	void (*destroy)(struct wit_generator *g);
+
+	uint32_t rate;	/* steps per second */
+	uint32_t seat;	/* index of seat which devices are used (0) */
+};
+
+static inline int
+wit_generator_emit_one(struct wit_generator *g, struct wit_display *d)
+{
+	return g->emit_one(g, d);
+}
+
+static inline void
+wit_generator_destroy(struct wit_generator *g)
+{
+	g->destroy(g);
+}
+
+/* ===
+ *  Pointer
+   === */
+enum wit_pointer_path_type {
+	WIT_PATH_LINE,		/* from -> to */
+	WIT_PATH_CIRCLE,	/* around center with radius, starts at angle 0 */
+	WIT_PATH_BEZIER,	/* cubic curve from -> to with control points
+				   c1 and c2 */
+	WIT_PATH_RANDOM_WALK	/* starts at from, every sample moves
+				   at most step in both axes */
+};
+
+struct wit_point {
+	double x;
+	double y;
+};
+
+struct wit_pointer_path {
+	enum wit_pointer_path_type type;
+
+	uint32_t rate;		/* samples per second (Hz), 0 = 1000 */
+	uint32_t samples;	/* number of motion events */
+
+	struct wit_point from;
+	struct wit_point to;
+	struct wit_point c1;
+	struct wit_point c2;
+	struct wit_point center;
+	double radius;
+	double step;
+	unsigned int seed;	/* for random walk */
+
+	/* when non-zero, the button is pressed before first motion
+	 * and released after the last one (drag) */
+	uint32_t button;
+};
+
+/**
+ * Create generator of pointer motion along the path
+ *
+ * When client has a surface (d->resources.surface), the pointer enters
+ * it before the first motion and leaves it at the end. Every event
+ * gets time stamp according to the sample rate (first event has
+ * time of its emission), button, enter and leave events get
+ * new serial. When the pointer resource is of version that supports
+ * wl_pointer.frame, every step is terminated by frame event.
+ *
+ * @param path   description of the path (copied)
+ * @return       generator (free it with wit_generator_destroy())
+ */
+struct wit_generator *
+wit_pointer_generator_create(const struct wit_pointer_path *path);
+
+/**
+ * Get position of the pointer on the path in given sample
+ *
+ * Random walk is not supported (depends on previous samples).
+ */
+struct wit_point
+wit_pointer_path_point(const struct wit_pointer_path *path, uint32_t sample);
+
+/* ===
+ *  Keyboard
+   === */
+struct wit_typing {
+	const char *text;	/* ASCII text to type (copied) */
+	uint32_t wpm;		/* words (5 characters) per minute, 0 = 60 */
+
+	/* when non-zero, this key is pressed after the text and held for
+	 * repeat_hold ms, so that client's key repeat fires */
+	char repeat_key;
+	uint32_t repeat_hold;
+};
+
+/**
+ * Create generator of typing
+ *
+ * Text is typed using evdev keycodes of us layout (characters that
+ * are not on us keyboard are skipped). Every character takes two steps,
+ * key press and key release, so the generator runs at wpm / 6 steps
+ * per second. Upper-case letters and other shifted characters are typed
+ * with left shift held and modifiers event is sent whenever shift
+ * changes. When client has a surface (d->resources.surface), keyboard
+ * enters it first and leaves it at the end.
+ *
+ * @param typing   description of typing
+ * @return         generator (free it with wit_generator_destroy())
+ */
+struct wit_generator *
+wit_keyboard_generator_create(const struct wit_typing *typing);
+
+/**
+ * Get evdev keycode of ASCII character (us layout)
+ *
+ * @param c      character
+ * @param shift  set to 1 when character needs shift, 0 otherwise
+ * @return       keycode or 0 when there's no key for the character
+ */
+uint32_t
+wit_keycode_from_char(char c, int *shift);
+
+/* ===
+ *  Touch
+   === */
+enum wit_touch_gesture_type {
+	WIT_GESTURE_SWIPE,	/* fingers move by distance in x axis */
+	WIT_GESTURE_PINCH,	/* radius changes by distance */
+	WIT_GESTURE_ROTATE	/* fingers rotate by distance radians */
+};
+
+struct wit_touch_gesture {
+	enum wit_touch_gesture_type type;
+
+	uint32_t fingers;	/* number of contacts (1 - 10) */
+	uint32_t rate;		/* frames per second (Hz), 0 = 240 */
+	uint32_t samples;	/* number of motion frames */
+
+	/* fingers are evenly spread on circle around center */
+	struct wit_point center;
+	double radius;
+	double distance;
+
+	/* end the gesture with wl_touch.cancel instead of up events */
+	int cancel;
+};
+
+/**
+ * Create generator of multi-touch gesture
+ *
+ * Gesture is emitted on the last surface created by client
+ * (d->resources.surface). Each step is one frame: first step puts
+ * all fingers down (ids 0 .. fingers - 1), following steps move all
+ * fingers and the last step lifts them up (or cancels the touch
+ * sequence). Every step except cancel is terminated by wl_touch.frame.
+ *
+ * @param gesture   description of the gesture
+ * @return          generator (free it with wit_generator_destroy())
+ */
+struct wit_generator *
+wit_touch_generator_create(const struct wit_touch_gesture *gesture);
+
+/**
+ * Get position of the finger in given sample (0 is position of down)
+ */
+struct wit_point
+wit_touch_gesture_point(const struct wit_touch_gesture *gesture,
+			uint32_t finger, uint32_t sample);
+
+#endif /* __WIT_GENERATOR_H__ */
@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <linux/input-event-codes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "server.h"
+#include "generator.h"
+
+/* mask of shift in modifiers of xkb keymaps */
+#define MOD_SHIFT_MASK 1
+
+/* rows of us keyboard, keycodes in a row are consecutive */
+static const struct {
+	const char *plain;
+	const char *shifted;
+	uint32_t first_key;
+} rows[] = {
+	{"1234567890-=", "!@#$%^&*()_+", KEY_1},
+	{"qwertyuiop[]", "QWERTYUIOP{}", KEY_Q},
+	{"asdfghjkl;'`", "ASDFGHJKL:\"~", KEY_A},
+	{"\\zxcvbnm,./", "|ZXCVBNM<>?", KEY_BACKSLASH}
+};
+
+uint32_t
+wit_keycode_from_char(char c, int *shift)
+{
+	unsigned int i;
+	const char *pos;
+
+	assert(shift);
+	*shift = 0;
+
+	switch (c) {
+		case ' ':
+			return KEY_SPACE;
+		case '\n':
+			return KEY_ENTER;
+		case '\t':
+			return KEY_TAB;
+		case '\0':
+			return 0;
+	}
+
+	for (i = 0; i < sizeof rows / sizeof rows[0]; i++) {
+		if ((pos = strchr(rows[i].plain, c)))
+			return rows[i].first_key + (pos - rows[i].plain);
+
+		if ((pos = strchr(rows[i].shifted, c))) {
+			*shift = 1;
+			return rows[i].first_key + (pos - rows[i].shifted);
+		}
+	}
+
+	return 0;
+}
+
+enum stage {
+	STAGE_ENTER,
+	STAGE_PRESS,
+	STAGE_HOLD,
+	STAGE_RELEASE,
+	STAGE_LEAVE,
+	STAGE_DONE
+};
+
+struct stroke {
+	uint32_t key;
+	int shift;
+	uint32_t hold;	/* steps to hold the key */
+};
+
+struct keyboard_generator {
+	struct wit_generator base;
+
+	struct stroke *strokes;
+	unsigned int count;
+	unsigned int current;	/* current stroke */
+	uint32_t held;		/* steps current stroke is held */
+
+	enum stage stage;
+	int steps;		/* steps left */
+	uint32_t step;		/* steps done */
+
+	int started;
+	uint32_t start_time;	/* ms */
+
+	/* surface that keyboard entered */
+	struct wl_resource *surface;
+	struct wl_listener surface_destroy;
+};
+
+static uint32_t
+time_msec(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct keyboard_generator *kg
+		= wl_container_of(listener, kg, surface_destroy);
+
+	kg->surface = NULL;
+}
+
+static void
+start(struct keyboard_generator *kg, struct wit_display *d)
+{
+	kg->started = 1;
+	kg->start_time = time_msec();
+
+	if (d->resources.surface) {
+		kg->surface = d->resources.surface;
+		kg->surface_destroy.notify = handle_surface_destroy;
+		wl_resource_add_destroy_listener(kg->surface,
+						 &kg->surface_destroy);
+		kg->stage = STAGE_ENTER;
+	} else {
+		kg->steps -= 2; /* no enter and leave */
+		kg->stage = kg->count ? STAGE_PRESS : STAGE_DONE;
+	}
+}
+
+static void
+send_shift(struct wit_display *d, struct wl_resource *keyboard,
+	   uint32_t time, uint32_t state)
+{
+	wl_keyboard_send_key(keyboard, wl_display_next_serial(d->display),
+			     time, KEY_LEFTSHIFT, state);
+	wl_keyboard_send_modifiers(keyboard, wl_display_next_serial(d->display),
+				   state ? MOD_SHIFT_MASK : 0, 0, 0, 0);
+}
+
+static enum stage
+stage_after_release(struct keyboard_generator *kg)
+{
+	if (++kg->current < kg->count)
+		return STAGE_PRESS;
+	else if (kg->surface)
+		return STAGE_LEAVE;
+	else
+		return STAGE_DONE;
+}
+
+static int
+keyboard_generator_emit_one(struct wit_generator *g, struct wit_display *d)
+{
+	struct keyboard_generator *kg = (struct keyboard_generator *) g;
+	struct wl_resource *keyboard
+		= wit_display_get_seat(d, g->seat)->resources.keyboard;
+	struct stroke *s;
+	struct wl_array keys;
+	uint32_t time;
+
+	assertf(keyboard, "Keyboard generator needs keyboard resource");
+
+	if (!kg->started) {
+		start(kg, d);
+
+		/* nothing to type and nowhere to enter */
+		if (kg->steps == 0)
+			return 0;
+	}
+
+	assertf(kg->stage != STAGE_DONE, "Keyboard generator is exhausted");
+
+	time = kg->start_time + (uint64_t) kg->step * 1000 / g->rate;
+	s = &kg->strokes[kg->current];
+
+	switch (kg->stage) {
+		case STAGE_ENTER:
+			wl_array_init(&keys);
+			wl_keyboard_send_enter(keyboard,
+					       wl_display_next_serial(d->display),
+					       kg->surface, &keys);
+			wl_keyboard_send_modifiers(keyboard,
+					wl_display_next_serial(d->display),
+					0, 0, 0, 0);
+			kg->stage = kg->count ? STAGE_PRESS : STAGE_LEAVE;
+			break;
+		case STAGE_PRESS:
+			if (s->shift)
+				send_shift(d, keyboard, time,
+					   WL_KEYBOARD_KEY_STATE_PRESSED);
+
+			wl_keyboard_send_key(keyboard,
+					     wl_display_next_serial(d->display),
+					     time, s->key,
+					     WL_KEYBOARD_KEY_STATE_PRESSED);
+
+			kg->held = 0;
+			kg->stage = s->hold ? STAGE_HOLD : STAGE_RELEASE;
+			break;
+		case STAGE_HOLD:
+			/* nothing to send, client repeats the key itself */
+			if (++kg->held == s->hold)
+				kg->stage = STAGE_RELEASE;
+			break;
+		case STAGE_RELEASE:
+			wl_keyboard_send_key(keyboard,
+					     wl_display_next_serial(d->display),
+					     time, s->key,
+					     WL_KEYBOARD_KEY_STATE_RELEASED);
+
+			if (s->shift)
+				send_shift(d, keyboard, time,
+					   WL_KEYBOARD_KEY_STATE_RELEASED);
+
+			kg->stage = stage_after_release(kg);
+			break;
+		case STAGE_LEAVE:
+			/* surface could have been destroyed in the meantime */
+			if (kg->surface)
+				wl_keyboard_send_leave(keyboard,
+						wl_display_next_serial(d->display),
+						kg->surface);
+			kg->stage = STAGE_DONE;
+			break;
+		default:
+			assertf(0, "Unknown stage");
+	}
+
+	kg->step++;
+	return --kg->steps;
+}
+
+static void
+keyboard_generator_destroy(struct wit_generator *g)
+{
+	struct keyboard_generator *kg = (struct keyboard_generator *) g;
+
+	if (kg->surface)
+		wl_list_remove(&kg->surface_destroy.link);
+
+	free(kg->strokes);
+	free(kg);
+}
+
+struct wit_generator *
+wit_keyboard_generator_create(const struct wit_typing *typing)
+{
+	struct keyboard_generator *kg;
+	const char *c;
+	size_t len;
+	uint32_t wpm;
+	struct stroke *s;
+
+	assert(typing);
+
+	kg = calloc(1, sizeof *kg);
+	assert(kg && "Out of memory");
+
+	len = typing->text ? strlen(typing->text) : 0;
+	kg->strokes = calloc(len + 1, sizeof *kg->strokes);
+	assert(kg->strokes && "Out of memory");
+
+	wpm = typing->wpm ? typing->wpm : 60;
+
+	/* two steps per character, word is 5 characters */
+	kg->base.rate = (wpm + 3) / 6;
+	if (kg->base.rate == 0)
+		kg->base.rate = 1;
+
+	for (c = typing->text; c && *c; c++) {
+		s = &kg->strokes[kg->count];
+		s->key = wit_keycode_from_char(*c, &s->shift);
+
+		if (s->key == 0) {
+			dbg("Skipping character '%c' (%#x)\n", *c, *c);
+			continue;
+		}
+
+		kg->count++;
+	}
+
+	if (typing->repeat_key) {
+		s = &kg->strokes[kg->count];
+		s->key = wit_keycode_from_char(typing->repeat_key, &s->shift);
+		assertf(s->key, "No key for character '%c'", typing->repeat_key);
+
+		s->hold = (uint64_t) typing->repeat_hold * kg->base.rate / 1000;
+		kg->count++;
+	}
+
+	/* enter, press and release, hold, leave */
+	kg->steps = 2 + 2 * kg->count;
+	if (kg->count)
+		kg->steps += kg->strokes[kg->count - 1].hold;
+
+	kg->base.emit_one = keyboard_generator_emit_one;
+	kg->base.destroy = keyboard_generator_destroy;
+
+	return &kg->base;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "keymap.h"
+
+/* us layout resolved by client's libxkbcommon */
+const char wit_default_keymap[] =
+	"xkb_keymap {\n"
+	"	xkb_keycodes  { include \"evdev+aliases(qwerty)\" };\n"
+	"	xkb_types     { include \"complete\" };\n"
+	"	xkb_compat    { include \"complete\" };\n"
+	"	xkb_symbols   { include \"pc+us+inet(evdev)\" };\n"
+	"	xkb_geometry  { include \"pc(pc105)\" };\n"
+	"};\n";
+
+static int
+create_keymap_file(void)
+{
+	int fd;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("wit-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0)
+		return fd;
+
+	dbg("memfd_create failed (%s), using temporary file\n",
+	    strerror(errno));
+#endif
+
+	char template[] = "/tmp/wit-keymap-XXXXXX";
+
+	fd = mkstemp(template);
+	if (fd < 0)
+		return -1;
+
+	unlink(template);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	return fd;
+}
+
+int
+wit_keymap_create_fd(const char *keymap, uint32_t *size)
+{
+	int fd;
+	size_t len, written = 0;
+	ssize_t stat;
+
+	assert(keymap);
+	assert(size);
+
+	/* keymap must be null-terminated */
+	len = strlen(keymap) + 1;
+
+	fd = create_keymap_file();
+	if (fd < 0)
+		return -1;
+
+	while (written < len) {
+		stat = write(fd, keymap + written, len - written);
+		if (stat < 0) {
+			if (errno == EINTR)
+				continue;
+
+			close(fd);
+			return -1;
+		}
+
+		written += stat;
+	}
+
+#ifdef HAVE_MEMFD_CREATE
+	/* clients must not be able to change keymap of other clients */
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+		  | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+		dbg("Sealing keymap failed (%s)\n", strerror(errno));
+#endif
+
+	*size = len;
+	return fd;
+}
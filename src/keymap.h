@@ -0,0 +1,23 @@
+#ifndef __WIT_KEYMAP_H__
+#define __WIT_KEYMAP_H__
+
+#include <stdint.h>
+
+/* keymap sent to clients when no other keymap is configured */
+extern const char wit_default_keymap[];
+
+/**
+ * Create file descriptor with keymap for wl_keyboard.keymap
+ *
+ * Keymap is stored in memfd sealed against writing, shrinking and
+ * growing, so it can be shared by all clients. When memfd_create() is
+ * not available, unlinked temporary file is used instead (without seals).
+ *
+ * @param keymap   xkb keymap as string (terminating NUL is stored too)
+ * @param size     size of the keymap is stored here
+ * @return         file descriptor or -1 on error
+ */
+int
+wit_keymap_create_fd(const char *keymap, uint32_t *size);
+
+#endif /* __WIT_KEYMAP_H__ */
@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "server.h"
+#include "generator.h"
+
+enum stage {
+	STAGE_ENTER,
+	STAGE_PRESS,
+	STAGE_MOTION,
+	STAGE_RELEASE,
+	STAGE_LEAVE,
+	STAGE_DONE
+};
+
+struct pointer_generator {
+	struct wit_generator base;
+	struct wit_pointer_path path;
+
+	enum stage stage;
+	uint32_t sample;	/* next motion sample */
+	int steps;		/* steps left */
+
+	int started;
+	uint32_t start_time;	/* ms */
+
+	struct wit_point pos;	/* position for random walk */
+
+	/* surface that pointer entered */
+	struct wl_resource *surface;
+	struct wl_listener surface_destroy;
+};
+
+static uint32_t
+time_msec(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+struct wit_point
+wit_pointer_path_point(const struct wit_pointer_path *path, uint32_t sample)
+{
+	struct wit_point p;
+	double t, u, angle;
+
+	/* position on the path in <0, 1> */
+	if (path->samples > 1)
+		t = (double) sample / (path->samples - 1);
+	else
+		t = 0.0;
+	u = 1.0 - t;
+
+	switch (path->type) {
+		case WIT_PATH_LINE:
+			p.x = path->from.x + (path->to.x - path->from.x) * t;
+			p.y = path->from.y + (path->to.y - path->from.y) * t;
+			break;
+		case WIT_PATH_CIRCLE:
+			/* don't repeat the first point at the end */
+			angle = 2 * M_PI * sample / path->samples;
+			p.x = path->center.x + path->radius * cos(angle);
+			p.y = path->center.y + path->radius * sin(angle);
+			break;
+		case WIT_PATH_BEZIER:
+			p.x = u * u * u * path->from.x
+				+ 3 * u * u * t * path->c1.x
+				+ 3 * u * t * t * path->c2.x
+				+ t * t * t * path->to.x;
+			p.y = u * u * u * path->from.y
+				+ 3 * u * u * t * path->c1.y
+				+ 3 * u * t * t * path->c2.y
+				+ t * t * t * path->to.y;
+			break;
+		default:
+			assertf(0, "Unsupported path type (%d)", path->type);
+	}
+
+	return p;
+}
+
+static struct wit_point
+next_point(struct pointer_generator *pg)
+{
+	double r;
+
+	if (pg->path.type != WIT_PATH_RANDOM_WALK)
+		return wit_pointer_path_point(&pg->path, pg->sample);
+
+	/* first sample is the starting point */
+	if (pg->sample > 0) {
+		r = (double) rand_r(&pg->path.seed) / RAND_MAX;
+		pg->pos.x += (2 * r - 1) * pg->path.step;
+		r = (double) rand_r(&pg->path.seed) / RAND_MAX;
+		pg->pos.y += (2 * r - 1) * pg->path.step;
+	}
+
+	return pg->pos;
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct pointer_generator *pg
+		= wl_container_of(listener, pg, surface_destroy);
+
+	pg->surface = NULL;
+}
+
+static void
+start(struct pointer_generator *pg, struct wit_display *d)
+{
+	pg->started = 1;
+	pg->start_time = time_msec();
+
+	if (d->resources.surface) {
+		pg->surface = d->resources.surface;
+		pg->surface_destroy.notify = handle_surface_destroy;
+		wl_resource_add_destroy_listener(pg->surface,
+						 &pg->surface_destroy);
+		pg->stage = STAGE_ENTER;
+	} else {
+		pg->steps -= 2; /* no enter and leave */
+		pg->stage = pg->path.button ? STAGE_PRESS : STAGE_MOTION;
+	}
+}
+
+static enum stage
+stage_after_motion(struct pointer_generator *pg)
+{
+	if (pg->path.button)
+		return STAGE_RELEASE;
+	else if (pg->surface)
+		return STAGE_LEAVE;
+	else
+		return STAGE_DONE;
+}
+
+static int
+pointer_generator_emit_one(struct wit_generator *g, struct wit_display *d)
+{
+	struct pointer_generator *pg = (struct pointer_generator *) g;
+	struct wl_resource *pointer
+		= wit_display_get_seat(d, g->seat)->resources.pointer;
+	struct wit_point p;
+	uint32_t time;
+
+	assertf(pointer, "Pointer generator needs pointer resource");
+
+	if (!pg->started)
+		start(pg, d);
+
+	assertf(pg->stage != STAGE_DONE, "Pointer generator is exhausted");
+
+	/* time of current sample */
+	time = pg->start_time + (uint64_t) pg->sample * 1000 / pg->path.rate;
+
+	switch (pg->stage) {
+		case STAGE_ENTER:
+			/* random walk can't be computed ahead */
+			if (pg->path.type == WIT_PATH_RANDOM_WALK)
+				p = pg->path.from;
+			else
+				p = wit_pointer_path_point(&pg->path, 0);
+
+			wl_pointer_send_enter(pointer,
+					      wl_display_next_serial(d->display),
+					      pg->surface, wl_fixed_from_double(p.x),
+					      wl_fixed_from_double(p.y));
+			pg->stage = pg->path.button ? STAGE_PRESS : STAGE_MOTION;
+			break;
+		case STAGE_PRESS:
+			wl_pointer_send_button(pointer,
+					       wl_display_next_serial(d->display),
+					       time, pg->path.button,
+					       WL_POINTER_BUTTON_STATE_PRESSED);
+			pg->stage = STAGE_MOTION;
+			break;
+		case STAGE_MOTION:
+			p = next_point(pg);
+			wl_pointer_send_motion(pointer, time,
+					       wl_fixed_from_double(p.x),
+					       wl_fixed_from_double(p.y));
+
+			if (++pg->sample == pg->path.samples)
+				pg->stage = stage_after_motion(pg);
+			break;
+		case STAGE_RELEASE:
+			/* release comes with the last sample */
+			time = pg->start_time + (uint64_t) (pg->sample - 1) * 1000
+				/ pg->path.rate;
+			wl_pointer_send_button(pointer,
+					       wl_display_next_serial(d->display),
+					       time, pg->path.button,
+					       WL_POINTER_BUTTON_STATE_RELEASED);
+			pg->stage = pg->surface ? STAGE_LEAVE : STAGE_DONE;
+			break;
+		case STAGE_LEAVE:
+			/* surface could have been destroyed in the meantime */
+			if (pg->surface)
+				wl_pointer_send_leave(pointer,
+						wl_display_next_serial(d->display),
+						pg->surface);
+			pg->stage = STAGE_DONE;
+			break;
+		default:
+			assertf(0, "Unknown stage");
+	}
+
+#ifdef WL_POINTER_FRAME_SINCE_VERSION
+	if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION)
+		wl_pointer_send_frame(pointer);
+#endif
+
+	return --pg->steps;
+}
+
+static void
+pointer_generator_destroy(struct wit_generator *g)
+{
+	struct pointer_generator *pg = (struct pointer_generator *) g;
+
+	if (pg->surface)
+		wl_list_remove(&pg->surface_destroy.link);
+
+	free(pg);
+}
+
+struct wit_generator *
+wit_pointer_generator_create(const struct wit_pointer_path *path)
+{
+	struct pointer_generator *pg;
+
+	assert(path);
+	assertf(path->samples > 0, "Path must have at least one sample");
+
+	pg = calloc(1, sizeof *pg);
+	assert(pg && "Out of memory");
+
+	pg->path = *path;
+	if (pg->path.rate == 0)
+		pg->path.rate = 1000;
+
+	pg->pos = path->from;
+
+	/* enter, (press), motion, (release), leave */
+	pg->steps = path->samples + 2 + (path->button ? 2 : 0);
+
+	pg->base.emit_one = pointer_generator_emit_one;
+	pg->base.destroy = pointer_generator_destroy;
+	pg->base.rate = pg->path.rate;
+
+	return &pg->base;
+}
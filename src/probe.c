@@ -0,0 +1,201 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <wayland-util.h>
+
+#include "wit-assert.h"
+#include "probe.h"
+
+/* probe of the display, forked client inherits it */
+static struct wit_probe *current_probe = NULL;
+
+static uint64_t
+probe_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t
+probe_mapping_size(uint32_t size)
+{
+	return sizeof(struct wit_probe)
+		+ (size_t) size * sizeof(struct wit_probe_stamp);
+}
+
+struct wit_probe *
+wit_probe_create(uint32_t size)
+{
+	struct wit_probe *p;
+
+	if (size == 0)
+		size = WIT_PROBE_DEFAULT_SIZE;
+
+	/* shared anonymous mapping survives fork() as shared memory */
+	p = mmap(NULL, probe_mapping_size(size), PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assertf(p != MAP_FAILED, "Failed mapping probe memory: %m");
+
+	/* mapping is zeroed */
+	p->size = size;
+
+	current_probe = p;
+
+	return p;
+}
+
+void
+wit_probe_destroy(struct wit_probe *p)
+{
+	assert(p);
+
+	if (current_probe == p)
+		current_probe = NULL;
+
+	munmap(p, probe_mapping_size(p->size));
+}
+
+void
+wit_probe_posted(struct wit_probe *p, const struct wl_interface *intf,
+		 uint32_t opcode)
+{
+	struct wit_probe_stamp *s;
+
+	if (p->posted == p->size) {
+		p->dropped++;
+		return;
+	}
+
+	s = &p->stamps[p->posted];
+	s->interface = intf;
+	s->opcode = opcode;
+	s->posted = probe_now();
+
+	/* client must see the stamp once it sees the counter */
+	__atomic_store_n(&p->posted, p->posted + 1, __ATOMIC_RELEASE);
+}
+
+void
+wit_probe_dispatched(const struct wl_interface *intf, uint32_t opcode)
+{
+	struct wit_probe *p = current_probe;
+	struct wit_probe_stamp *s;
+	uint64_t now;
+	uint32_t i, posted;
+
+	if (!p)
+		return;
+
+	now = probe_now();
+	posted = __atomic_load_n(&p->posted, __ATOMIC_ACQUIRE);
+
+	/* events come in the same order as they were posted, skip
+	 * the ones that client didn't stamp */
+	for (i = p->dispatched; i < posted; i++) {
+		s = &p->stamps[i];
+
+		if (s->interface == intf && s->opcode == opcode) {
+			s->dispatched = now;
+			p->dispatched = i + 1;
+			return;
+		}
+	}
+
+	/* probe is full, event was not stamped by display */
+	ifdbg(posted < p->size, "Dispatched event %s@%u that was not posted\n",
+	      intf->name, opcode);
+}
+
+size_t
+wit_probe_stats(struct wit_probe *p, struct wit_stats *s,
+		const struct wl_interface *intf, uint32_t opcode)
+{
+	uint64_t *samples;
+	size_t n = 0;
+	uint32_t i;
+
+	assert(p && s);
+
+	samples = malloc((p->posted + 1) * sizeof *samples);
+	assertf(samples, "Out of memory");
+
+	for (i = 0; i < p->posted; i++) {
+		if (p->stamps[i].dispatched == 0)
+			continue;
+		if (intf && (p->stamps[i].interface != intf
+			     || p->stamps[i].opcode != opcode))
+			continue;
+
+		samples[n++] = p->stamps[i].dispatched - p->stamps[i].posted;
+	}
+
+	wit_stats_compute(s, samples, n);
+	free(samples);
+
+	return n;
+}
+
+void
+wit_probe_report(struct wit_probe *p, FILE *f)
+{
+	struct wit_probe_stamp *s, *prev;
+	struct wit_stats st;
+	uint32_t i, j;
+
+	assert(p && f);
+
+	for (i = 0; i < p->posted; i++) {
+		s = &p->stamps[i];
+
+		/* report every interface and opcode only once */
+		for (j = 0; j < i; j++) {
+			prev = &p->stamps[j];
+			if (prev->interface == s->interface
+			    && prev->opcode == s->opcode)
+				break;
+		}
+
+		if (j < i)
+			continue;
+
+		if (wit_probe_stats(p, &st, s->interface, s->opcode) == 0)
+			continue;
+
+		fprintf(f, "Latency %s@%u: %zu events, p50 %.1f us, "
+			"p99 %.1f us, max %.1f us\n", s->interface->name,
+			s->opcode, st.count, st.median / 1000.0,
+			st.p99 / 1000.0, st.max / 1000.0);
+	}
+
+	if (p->dropped)
+		fprintf(f, "Latency: %u events didn't fit into probe\n",
+			p->dropped);
+}
@@ -0,0 +1,90 @@
+#ifndef __WIT_PROBE_H__
+#define __WIT_PROBE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+struct wl_interface;
+
+/* default number of stamps in probe */
+#define WIT_PROBE_DEFAULT_SIZE 65536
+
+/* times are CLOCK_MONOTONIC in nanoseconds */
+struct wit_probe_stamp {
+	const struct wl_interface *interface;
+	uint32_t opcode;
+
+	uint64_t posted;	/* stamped by display */
+	uint64_t dispatched;	/* stamped by client, 0 = not dispatched */
+};
+
+/**
+ * End-to-end latency probe
+ *
+ * Display stamps time of every event posted by wit_eventarray_emit_one()
+ * into shared memory (indexed by sequence of posting), client stamps the
+ * time when the event got into its listener by calling
+ * wit_probe_dispatched(). The memory is mapped before client is forked,
+ * so both processes see the same stamps.
+ */
+struct wit_probe {
+	uint32_t size;		/* number of stamps */
+	uint32_t posted;	/* number of posted events (display) */
+	uint32_t dispatched;	/* next stamp to be checked (client) */
+	uint32_t dropped;	/* events that didn't fit into the probe */
+
+	struct wit_probe_stamp stamps[];
+};
+
+/**
+ * Create probe with space for size events
+ *
+ * Must be called before client is forked. Created probe becomes the
+ * one used by wit_probe_dispatched().
+ *
+ * @param size   number of events (0 = WIT_PROBE_DEFAULT_SIZE)
+ */
+struct wit_probe *
+wit_probe_create(uint32_t size);
+
+void
+wit_probe_destroy(struct wit_probe *p);
+
+/* stamp event that is being posted to client */
+void
+wit_probe_posted(struct wit_probe *p, const struct wl_interface *intf,
+		 uint32_t opcode);
+
+/**
+ * Stamp dispatching of event in client
+ *
+ * Call this from listener of events emitted by display. Events that
+ * are not stamped by client (e. g. client has no listener for them)
+ * are skipped and not counted into results. When there's no probe,
+ * this function does nothing.
+ *
+ * @param intf     interface of object that got the event
+ * @param opcode   opcode of the event
+ */
+void
+wit_probe_dispatched(const struct wl_interface *intf, uint32_t opcode);
+
+/**
+ * Compute statistics of latencies of events
+ *
+ * @param s       where to store results (in nanoseconds)
+ * @param intf    interface of events (NULL = all events)
+ * @param opcode  opcode of events (ignored when intf is NULL)
+ * @return        number of dispatched events
+ */
+size_t
+wit_probe_stats(struct wit_probe *p, struct wit_stats *s,
+		const struct wl_interface *intf, uint32_t opcode);
+
+/* print p50/p99/max for every interface and opcode */
+void
+wit_probe_report(struct wit_probe *p, FILE *f);
+
+#endif /* __WIT_PROBE_H__ */
@@ -27,8 +27,12 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <poll.h>
 #include <wait.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
 #include <time.h>
 
 #include <wayland-server.h>
@@ -49,6 +53,10 @@ const struct wit_config wit_default_config = {
 
 static void display_create_globals(struct wit_display *d);
 
+/* definition can be found in wit-server-protocol.c */
+void surface_free(struct wit_surface *s);
+struct wit_surface *surface_from_object(struct wl_resource *resource);
+
 /*
  * Terminate display when client exited
  */
@@ -72,38 +80,603 @@ handle_sigchld(int signum, void *data)
 	return 0;
 }
 
-/* emit n events from d->events eventarray */
+/*
+ * Synthetic latency
+ */
+static int
+handle_latency_timer(int fd, uint32_t mask, void *data)
+{
+	struct wit_display *d = data;
+	uint64_t expirations;
+
+	assertf(read(fd, &expirations, sizeof expirations)
+		== sizeof expirations, "Reading timerfd failed");
+
+	d->latency.expired = 1;
+	return 0;
+}
+
+static int
+latency_configured(struct wit_config *conf)
+{
+	return conf->latency.ack_delay || conf->latency.flush_delay
+		|| conf->latency.jitter || conf->latency.max_event_rate
+		|| (conf->options & CONF_OPT_STRESS);
+}
+
+static void
+display_create_timer(struct wit_display *d)
+{
+	if (d->latency.fd >= 0)
+		return;
+
+	d->latency.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	assertf(d->latency.fd >= 0, "Failed creating timerfd: %m");
+
+	d->latency.source = wl_event_loop_add_fd(d->loop, d->latency.fd,
+						 WL_EVENT_READABLE,
+						 handle_latency_timer, d);
+	assertf(d->latency.source,
+		"Couldn't add latency timer to loop");
+}
+
+static void
+display_init_latency(struct wit_display *d)
+{
+	d->latency.fd = -1;
+
+	if (!latency_configured(&d->config))
+		return;
+
+	display_create_timer(d);
+
+	d->latency.seed = d->config.latency.seed;
+	if (d->latency.seed == 0)
+		d->latency.seed = time(NULL);
+}
+
+/* arm the latency timer and run wayland's loop until it expires */
+static void
+display_wait_timer(struct wit_display *d, const struct itimerspec *its,
+		   int flags)
+{
+	int stat;
+
+	d->latency.expired = 0;
+	stat = timerfd_settime(d->latency.fd, flags, its, NULL);
+	assertf(stat == 0, "Failed arming timerfd: %m");
+
+	/* flush replies like wl_display_run() does, so that they are not
+	 * delayed any more than configured */
+	while (!d->latency.expired) {
+		wl_display_flush_clients(d->display);
+		wl_event_loop_dispatch(d->loop, -1);
+	}
+}
+
+/* wait usec microseconds (+ jitter) while wayland's loop is running */
+static void
+display_delay(struct wit_display *d, uint32_t usec)
+{
+	struct itimerspec its = {{0, 0}, {0, 0}};
+	uint64_t delay = usec;
+
+	if (d->latency.fd < 0)
+		return;
+
+	/* in 64 bits, jitter + 1 overflows for UINT32_MAX */
+	if (d->config.latency.jitter)
+		delay += rand_r(&d->latency.seed)
+			% ((uint64_t) d->config.latency.jitter + 1);
+
+	if (delay == 0)
+		return;
+
+	its.it_value.tv_sec = delay / 1000000;
+	its.it_value.tv_nsec = (delay % 1000000) * 1000;
+
+	display_wait_timer(d, &its, 0);
+}
+
+/* wait until next event can be emitted according to rate (events/s) */
+static void
+display_throttle(struct wit_display *d, uint32_t rate)
+{
+	struct timespec now;
+	struct itimerspec its = {{0, 0}, {0, 0}};
+	long interval;
+
+	if (rate == 0)
+		return;
+
+	interval = 1000000000L / rate;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (now.tv_sec < d->latency.next_event.tv_sec
+	    || (now.tv_sec == d->latency.next_event.tv_sec
+		&& now.tv_nsec < d->latency.next_event.tv_nsec)) {
+		its.it_value = d->latency.next_event;
+		display_wait_timer(d, &its, TFD_TIMER_ABSTIME);
+	} else {
+		/* we're late (or it's the first event), start from now */
+		d->latency.next_event = now;
+	}
+
+	d->latency.next_event.tv_nsec += interval;
+	while (d->latency.next_event.tv_nsec >= 1000000000L) {
+		d->latency.next_event.tv_nsec -= 1000000000L;
+		d->latency.next_event.tv_sec++;
+	}
+}
+
+/* emit one event from eventarray with respect to configured latency */
+static int
+display_emit_one(struct wit_display *d, struct wit_eventarray *ea)
+{
+	int stat;
+
+	display_throttle(d, d->config.latency.max_event_rate);
+	stat = wit_eventarray_emit_one(d, ea);
+
+	/* throttled events must be sent one by one */
+	if (d->config.latency.max_event_rate) {
+		display_delay(d, d->config.latency.flush_delay);
+		wl_display_flush_clients(d->display);
+	}
+
+	return stat;
+}
+
+/* flush emitted events with respect to configured latency */
+static void
+display_flush_events(struct wit_display *d)
+{
+	/* throttled events are flushed one by one */
+	if (d->config.latency.max_event_rate)
+		return;
+
+	display_delay(d, d->config.latency.flush_delay);
+	wl_display_flush_clients(d->display);
+}
+
+/*
+ * Stress mode
+ */
+static void
+stress_get_config(struct wit_display *d, uint32_t *start, uint32_t *max,
+		  uint32_t *step)
+{
+	*start = d->config.stress.start_rate ? d->config.stress.start_rate : 1000;
+	*max = d->config.stress.max_rate ? d->config.stress.max_rate : 1024000;
+	*step = d->config.stress.step ? d->config.stress.step : 100;
+
+	assertf(*start <= *max, "Stress start rate is greater than max rate");
+}
+
+/* how many events is emitted in one step with given rate */
+static uint32_t
+stress_step_events(uint32_t rate, uint32_t step)
+{
+	uint64_t n = (uint64_t) rate * step / 1000;
+
+	return n ? n : 1;
+}
+
+/* how many events will be emitted if client survives */
+static int
+stress_planned_events(struct wit_display *d)
+{
+	uint32_t rate, start, max, step;
+	uint64_t n = 0;
+
+	stress_get_config(d, &start, &max, &step);
+
+	for (rate = start; rate <= max && rate != 0; rate *= 2)
+		n += stress_step_events(rate, step);
+
+	return n > INT32_MAX ? INT32_MAX : n;
+}
+
+/* after wl_display_flush_clients() the socket stays full only when
+ * flushing ended up with EAGAIN */
+static int
+client_writable(struct wit_display *d)
+{
+	struct pollfd pfd;
+
+	pfd.fd = wl_client_get_fd(d->client);
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT);
+}
+
+/* flood client with events from d->events without waiting for it */
+static void
+emit_stress(struct wit_display *d)
+{
+	struct wit_stress_report *r = &d->stress;
+	uint32_t rate, start, max, step, i, n, eagain;
+
+	assertf(d->events && d->events->count > 0, "No events for stress mode");
+
+	stress_get_config(d, &start, &max, &step);
+	memset(r, 0, sizeof *r);
+
+	for (rate = start; rate <= max && rate != 0 && d->client; rate *= 2) {
+		n = stress_step_events(rate, step);
+		eagain = 0;
+
+		for (i = 0; i < n; i++) {
+			display_throttle(d, rate);
+
+			/* client could have been destroyed while we waited */
+			if (!d->client)
+				break;
+
+			/* go round the eventarray */
+			if (d->events->index == d->events->count)
+				d->events->index = 0;
+
+			wit_eventarray_emit_one(d, d->events);
+			r->emitted++;
+
+			wl_display_flush_clients(d->display);
+			if (d->client && !client_writable(d))
+				eagain++;
+		}
+
+		/* let wayland destroy client with broken connection */
+		wl_event_loop_dispatch(d->loop, 0);
+
+		r->flush_eagain += eagain;
+
+		if (!d->client) {
+			r->broken_rate = rate;
+			break;
+		}
+
+		r->steps++;
+
+		if (eagain == 0)
+			r->max_sustained_rate = rate;
+		else if (r->saturated_rate == 0)
+			r->saturated_rate = rate;
+	}
+
+	dbg("Stress: emitted %u events, %u flushes with EAGAIN, "
+	    "max sustained rate %u ev/s, saturated at %u ev/s, "
+	    "disconnected at %u ev/s\n", r->emitted, r->flush_eagain,
+	    r->max_sustained_rate, r->saturated_rate, r->broken_rate);
+}
+
+/*
+ * Timed events
+ */
+static void
+timespec_add_usec(struct timespec *ts, uint64_t usec)
+{
+	ts->tv_sec += usec / 1000000;
+	ts->tv_nsec += (usec % 1000000) * 1000;
+
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+static int
+timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec
+		|| (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/*
+ * Merging of eventarrays
+ */
+static int
+merge_item_before(const struct wit_merge_item *a,
+		  const struct wit_merge_item *b)
+{
+	uint64_t ta = wit_eventarray_next_time(a->ea);
+	uint64_t tb = wit_eventarray_next_time(b->ea);
+
+	return ta < tb || (ta == tb && a->order < b->order);
+}
+
+static void
+merge_swap(struct wit_display *d, unsigned int i, unsigned int j)
+{
+	struct wit_merge_item tmp = d->merge.items[i];
+
+	d->merge.items[i] = d->merge.items[j];
+	d->merge.items[j] = tmp;
+}
+
+static void
+merge_sift_up(struct wit_display *d, unsigned int i)
+{
+	while (i > 0 && merge_item_before(&d->merge.items[i],
+					  &d->merge.items[(i - 1) / 2])) {
+		merge_swap(d, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void
+merge_sift_down(struct wit_display *d, unsigned int i)
+{
+	unsigned int min, child;
+
+	for (;;) {
+		min = i;
+		child = 2 * i + 1;
+
+		if (child < d->merge.count
+		    && merge_item_before(&d->merge.items[child],
+					 &d->merge.items[min]))
+			min = child;
+		if (child + 1 < d->merge.count
+		    && merge_item_before(&d->merge.items[child + 1],
+					 &d->merge.items[min]))
+			min = child + 1;
+
+		if (min == i)
+			break;
+
+		merge_swap(d, i, min);
+		i = min;
+	}
+}
+
+static void
+merge_push(struct wit_display *d, struct wit_eventarray *ea,
+	   unsigned int order)
+{
+	if (ea->index == ea->count)
+		return;
+
+	if (d->merge.count == d->merge.size) {
+		d->merge.size = d->merge.size ? 2 * d->merge.size : 4;
+		d->merge.items = realloc(d->merge.items, d->merge.size
+					 * sizeof *d->merge.items);
+		assertf(d->merge.items, "Out of memory");
+	}
+
+	d->merge.items[d->merge.count].ea = ea;
+	d->merge.items[d->merge.count].order = order;
+	merge_sift_up(d, d->merge.count++);
+}
+
+/* build the heap from all eventarrays of display,
+ * returns number of events that are left in them */
+static int
+merge_init(struct wit_display *d)
+{
+	struct wit_eventarray **ea;
+	unsigned int order = 0;
+	int count = 0;
+
+	d->merge.count = 0;
+
+	if (d->events) {
+		merge_push(d, d->events, order++);
+		count += d->events->count - d->events->index;
+	}
+
+	wl_array_for_each(ea, &d->streams) {
+		merge_push(d, *ea, order++);
+		count += (*ea)->count - (*ea)->index;
+	}
+
+	return count;
+}
+
+/* eventarray with the earliest event or NULL */
+static struct wit_eventarray *
+merge_top(struct wit_display *d)
+{
+	if (d->merge.count == 0)
+		return NULL;
+
+	return d->merge.items[0].ea;
+}
+
+/* restore the heap after an event from the top eventarray was emitted */
+static void
+merge_pop(struct wit_display *d)
+{
+	struct wit_eventarray *ea = merge_top(d);
+
+	assert(ea);
+
+	if (ea->index == ea->count)
+		d->merge.items[0] = d->merge.items[--d->merge.count];
+
+	merge_sift_down(d, 0);
+}
+
+static int
+merge_timed(struct wit_display *d)
+{
+	struct wit_eventarray **ea;
+
+	if (d->events && d->events->timed)
+		return 1;
+
+	wl_array_for_each(ea, &d->streams)
+		if ((*ea)->timed)
+			return 1;
+
+	return 0;
+}
+
+/* arm schedule timer for the next timed event */
+static void
+schedule_arm(struct wit_display *d)
+{
+	struct itimerspec its = {{0, 0}, {0, 0}};
+	int stat;
+
+	its.it_value = d->schedule.start;
+	timespec_add_usec(&its.it_value,
+			  wit_eventarray_next_time(merge_top(d)));
+
+	/* zero would disarm the timer */
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;
+
+	stat = timerfd_settime(d->schedule.fd, TFD_TIMER_ABSTIME, &its, NULL);
+	assertf(stat == 0, "Failed arming timerfd: %m");
+}
+
+static int
+handle_schedule_timer(int fd, uint32_t mask, void *data)
+{
+	struct wit_display *d = data;
+	struct wit_eventarray *ea;
+	struct timespec now, due;
+	uint64_t expirations;
+
+	assertf(read(fd, &expirations, sizeof expirations)
+		== sizeof expirations, "Reading timerfd failed");
+
+	/* client is gone, nothing to emit to */
+	if (!d->client) {
+		d->schedule.left = 0;
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* emit all events which time has come */
+	while (d->schedule.left > 0 && (ea = merge_top(d))) {
+		due = d->schedule.start;
+		timespec_add_usec(&due, wit_eventarray_next_time(ea));
+
+		if (timespec_before(&now, &due))
+			break;
+
+		wit_eventarray_emit_one(d, ea);
+		merge_pop(d);
+		d->schedule.left--;
+	}
+
+	wl_display_flush_clients(d->display);
+
+	if (d->schedule.left > 0 && merge_top(d))
+		schedule_arm(d);
+	else
+		dbg("All timed events emitted\n");
+
+	return 0;
+}
+
+/* schedule emitting n events (0 = all) from timed eventarrays,
+ * returns how many events will be emitted */
+static int
+schedule_events(struct wit_display *d, int n)
+{
+	int count;
+
+	assertf(d->schedule.left == 0, "Timed events are being emitted already");
+
+	count = merge_init(d);
+
+	if (n == 0 || n > count)
+		n = count;
+
+	if (n == 0)
+		return 0;
+
+	if (d->schedule.fd < 0) {
+		d->schedule.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		assertf(d->schedule.fd >= 0, "Failed creating timerfd: %m");
+
+		d->schedule.source = wl_event_loop_add_fd(d->loop,
+							  d->schedule.fd,
+							  WL_EVENT_READABLE,
+							  handle_schedule_timer,
+							  d);
+		assertf(d->schedule.source,
+			"Couldn't add schedule timer to loop");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &d->schedule.start);
+	d->schedule.left = n;
+
+	schedule_arm(d);
+
+	return n;
+}
+
+/* emit n steps from d->generator (0 = until it is exhausted) */
+static int
+emit_generated(struct wit_display *d, int n)
+{
+	struct wit_generator *g = d->generator;
+	int i = 0, left = 1;
+
+	while (left > 0 && (n == 0 || i < n)) {
+		display_throttle(d, g->rate);
+		left = wit_generator_emit_one(g, d);
+		i++;
+
+		/* paced steps are sent one by one */
+		if (g->rate)
+			wl_display_flush_clients(d->display);
+	}
+
+	if (left == 0) {
+		dbg("Generator exhausted\n");
+		wit_generator_destroy(g);
+		d->generator = NULL;
+	}
+
+	display_flush_events(d);
+
+	return i;
+}
+
+/* emit n events (0 = all) from eventarrays merged by time of events */
 static int
 emit_events(struct wit_display *d, int n)
 {
 	int i = 0;
-	int m, count;
+	int count;
+	struct wit_eventarray *ea;
 
 	assertf(d, "No compositor");
 	assertf(n >= 0, "Wrong value of n");
+
+	if (d->generator)
+		return emit_generated(d, n);
+
 	assertf(d->events, "No eventarray");
 
 	/* how many events can be emitted (for assert()) */
-	count = d->events->count - d->events->index;
+	count = merge_init(d);
 
 	if (count == 0) {
 		dbg("No events in eventarray\n");
 		return 0;
 	}
 
-	if (n == 0) { /* 0 means all */
-		while(wit_eventarray_emit_one(d,d->events) > 0)
-			i++;
-		/* i begun at 0, so we have to add 1 before comparing */
-		assertf(++i == count, "Emitted %d instead of %d events", i, count);
-	} else {
-		for (m = 1; i < n && m > 0; i++) {
-			m = wit_eventarray_emit_one(d, d->events);
-		}
-		assertf(i == n || i == count,
-			"Emitted %d instead of %d events", i, n);
+	if (n == 0) /* 0 means all */
+		n = count;
+
+	while (i < n && (ea = merge_top(d))) {
+		display_emit_one(d, ea);
+		merge_pop(d);
+		i++;
 	}
 
+	assertf(i == n || i == count,
+		"Emitted %d instead of %d events", i, n);
+
+	display_flush_events(d);
+
 	return i;
 }
 
@@ -145,6 +718,9 @@ wit_display_process_request(struct wit_display *disp)
 	/* get orders */
 	assread(fd, &op, sizeof(op));
 
+	/* simulate slow display */
+	display_delay(disp, disp->config.latency.ack_delay);
+
 	switch(op) {
 		case CAN_CONTINUE:
 			assertf(0, "Got CAN_CONTINUE from child");
@@ -156,9 +732,10 @@ wit_display_process_request(struct wit_display *disp)
 				"Got more than one event");
 
 			dbg("Event recieved .. Emitting\n");
-			stat = wit_eventarray_emit_one(disp, ea);
+			stat = display_emit_one(disp, ea);
 			assertf(stat == 0, "There should be only one event");
 			wit_eventarray_free(ea);
+			display_flush_events(disp);
 
 			/* acknowledge */
 			send_message(fd, EVENT_EMIT, stat);
@@ -166,6 +743,25 @@ wit_display_process_request(struct wit_display *disp)
 		case EVENT_COUNT:
 			assread(fd, &count, sizeof(count));
 
+			if (disp->config.options & CONF_OPT_STRESS) {
+				/* client needs to read while we're flooding
+				 * it, so acknowledge first */
+				send_message(fd, EVENT_COUNT,
+					     stress_planned_events(disp));
+				emit_stress(disp);
+				break;
+			}
+
+			if (!disp->generator && merge_timed(disp)) {
+				/* events are emitted from wayland's loop
+				 * while client is running */
+				stat = schedule_events(disp, count);
+				dbg("Scheduled %d events\n", stat);
+
+				send_message(fd, EVENT_COUNT, stat);
+				break;
+			}
+
 			stat = emit_events(disp, count);
 			dbg("Emitted %d events (asked for %d)\n", stat, count);
 
@@ -283,6 +879,19 @@ wit_display_create(struct wit_config *conf)
 		"between client and server");
 
 	wl_list_init(&d->surfaces);
+	wl_array_init(&d->streams);
+
+	display_init_latency(d);
+
+	/* must be mapped before client is forked */
+	if (d->config.options & CONF_OPT_PROBE)
+		d->probe = wit_probe_create(d->config.probe.size);
+
+	/* created when timed events are emitted for the first time */
+	d->schedule.fd = -1;
+
+	/* keymap is created when first keyboard is created */
+	d->keyboard.keymap_fd = -1;
 
 	return d;
 }
@@ -305,6 +914,7 @@ wit_display_destroy(struct wit_display *d)
 	assert(d && "Invalid pointer given to destroy_compositor");
 
 	struct wit_surface *pos, *tmp;
+	struct wit_eventarray **ea;
 	int exit_c = d->client_exit_code;
 
 	if (d->data && d->data_destroy_func)
@@ -313,16 +923,44 @@ wit_display_destroy(struct wit_display *d)
 	if (d->events)
 		wit_eventarray_free(d->events);
 
+	wl_array_for_each(ea, &d->streams)
+		wit_eventarray_free(*ea);
+	wl_array_release(&d->streams);
+	free(d->merge.items);
+
+	if (d->generator)
+		wit_generator_destroy(d->generator);
+
+	free(d->snapshot_dir);
+
 	close(d->client_sock[0]);
 	close(d->client_sock[1]);
 
 	wl_list_for_each_safe(pos, tmp, &d->surfaces, link) {
-		free(pos);
+		surface_free(pos);
 	}
 
 	wl_event_source_remove(d->sigchld);
 	wl_event_source_remove(d->sigusr1);
 
+	if (d->latency.source)
+		wl_event_source_remove(d->latency.source);
+	if (d->latency.fd >= 0)
+		close(d->latency.fd);
+
+	if (d->keyboard.keymap_fd >= 0)
+		close(d->keyboard.keymap_fd);
+
+	if (d->schedule.source)
+		wl_event_source_remove(d->schedule.source);
+	if (d->schedule.fd >= 0)
+		close(d->schedule.fd);
+
+	if (d->probe) {
+		wit_probe_report(d->probe, stderr);
+		wit_probe_destroy(d->probe);
+	}
+
 	wl_display_destroy(d->display);
 
 	free(d);
@@ -369,6 +1007,23 @@ run_client(int (*client_main)(int), int wayland_sock, int client_sock)
 	return client_main(client_sock);
 }
 
+static void
+handle_client_destroy(struct wl_listener *listener, void *data)
+{
+	struct wit_display *d
+		= wl_container_of(listener, d, client_destroy);
+
+	uint32_t i;
+
+	/* resources are gone with client */
+	memset(&d->resources, 0, sizeof d->resources);
+	for (i = 0; i < d->seats_count; i++)
+		memset(&d->seats[i].resources, 0,
+		       sizeof d->seats[i].resources);
+
+	d->client = NULL;
+}
+
 static inline void
 handle_child_abort(int signum)
 {
@@ -431,6 +1086,10 @@ wit_display_create_client(struct wit_display *disp,
 			send_message(disp->client_sock[1], CAN_CONTINUE, 0);
 			assertf(disp->client, "Couldn't create wayland client");
 		}
+
+		disp->client_destroy.notify = handle_client_destroy;
+		wl_client_add_destroy_listener(disp->client,
+					       &disp->client_destroy);
 	}
 }
 
@@ -466,11 +1125,52 @@ wit_display_add_user_func(struct wit_display *disp,
 
 void
 wit_display_add_events(struct wit_display *d, struct wit_eventarray *e)
+{
+	struct wit_eventarray **ea;
+
+	assert(d);
+	assertf(e, "No eventarray given");
+	assertf(d->schedule.left == 0,
+		"Can't add eventarray while events are scheduled");
+
+	if (!d->events) {
+		d->events = e;
+		return;
+	}
+
+	dbg("Adding eventarray to be merged with the others\n");
+
+	ea = wl_array_add(&d->streams, sizeof *ea);
+	assertf(ea, "Out of memory");
+	*ea = e;
+}
+
+void
+wit_display_add_generator(struct wit_display *d, struct wit_generator *g)
+{
+	assert(d);
+	assert(g);
+
+	if (d->generator) {
+		dbg("Replacing old generator\n");
+		wit_generator_destroy(d->generator);
+	}
+
+	d->generator = g;
+
+	/* we need timer for pacing */
+	if (g->rate)
+		display_create_timer(d);
+}
+
+struct wit_seat *
+wit_display_get_seat(struct wit_display *d, uint32_t index)
 {
 	assert(d);
-	ifdbg(d->events, "Rewriting old eventarray\n");
+	assertf(index < d->seats_count, "Display has no seat %u (has %u)",
+		index, d->seats_count);
 
-	d->events = e;
+	return &d->seats[index];
 }
 
 void
@@ -484,6 +1184,8 @@ wit_display_recieve_eventarray(struct wit_display *d)
 	struct wit_eventarray *ea = wit_eventarray_recieve(d);
 	dbg("Eventarray recieved\n");
 
+	display_delay(d, d->config.latency.ack_delay);
+
 	/* acknowledge */
 	asswrite(d->client_sock[1], &op, sizeof(op));
 	asswrite(d->client_sock[1], &ea->count, sizeof(unsigned));
@@ -494,6 +1196,92 @@ wit_display_recieve_eventarray(struct wit_display *d)
 	wl_display_run(d->display);
 }
 
+struct wit_surface *
+wit_display_get_surface(struct wit_display *d, uint32_t id)
+{
+	struct wit_surface *s;
+	struct wl_resource *res;
+
+	assert(d);
+
+	/* look it up in client's objects while client is connected */
+	if (d->client) {
+		res = wl_client_get_object(d->client, id);
+
+		return res ? surface_from_object(res) : NULL;
+	}
+
+	/* resources are gone with client, but wit_surfaces are kept */
+	wl_list_for_each(s, &d->surfaces, link) {
+		if (s->id == id)
+			return s;
+	}
+
+	return NULL;
+}
+
+uint32_t
+wit_surface_get_checksum(struct wit_surface *s)
+{
+	assert(s);
+	assertf(s->checksums.size > 0, "No buffer commited on surface");
+
+	return ((uint32_t *) s->checksums.data)
+		[s->checksums.size / sizeof(uint32_t) - 1];
+}
+
+void
+wit_display_set_snapshot_dir(struct wit_display *d, const char *dir)
+{
+	int stat;
+
+	assert(d);
+
+	free(d->snapshot_dir);
+	d->snapshot_dir = NULL;
+
+	if (!dir)
+		return;
+
+	stat = mkdir(dir, 0755);
+	assertf(stat == 0 || errno == EEXIST,
+		"Failed creating snapshot directory '%s': %m", dir);
+
+	d->snapshot_dir = strdup(dir);
+	assert(d->snapshot_dir && "Out of memory");
+}
+
+size_t
+wit_display_compare_golden(struct wit_display *d, struct wit_surface *s,
+			   const char *golden, uint8_t tolerance)
+{
+	struct wit_snapshot *last, *gold;
+	size_t diff;
+
+	assert(d && s && golden);
+	assertf(d->snapshot_dir, "Snapshot store is not set");
+
+	last = wit_snapshot_store_load(d->snapshot_dir,
+				       wit_surface_get_checksum(s));
+	if (!last)
+		return WIT_SNAPSHOT_INCOMPARABLE;
+
+	gold = wit_snapshot_load(golden);
+	if (!gold) {
+		wit_snapshot_free(last);
+		return WIT_SNAPSHOT_INCOMPARABLE;
+	}
+
+	diff = wit_snapshot_compare(last, gold, tolerance);
+	ifdbg(diff != 0, "Surface %u differs from '%s' in %lu pixels\n",
+	      s->id, golden, diff);
+
+	wit_snapshot_free(last);
+	wit_snapshot_free(gold);
+
+	return diff;
+}
+
 /*
  * Wayland bindings
  */
@@ -501,23 +1289,64 @@ wit_display_recieve_eventarray(struct wit_display *d)
 /* definitions can be found in wit-server-protocol.c */
 void seat_bind(struct wl_client *, void *, uint32_t, uint32_t);
 void compositor_bind(struct wl_client *, void *, uint32_t, uint32_t);
+void synthetic_bind(struct wl_client *, void *, uint32_t, uint32_t);
+
+static void
+display_create_seats(struct wit_display *d)
+{
+	const uint32_t all = CONF_POINTER | CONF_KEYBOARD | CONF_TOUCH;
+	struct wit_seat *seat;
+	uint32_t i;
+
+	assertf(d->config.seats.count <= WIT_MAX_SEATS,
+		"Too many seats (%u), maximum is %d",
+		d->config.seats.count, WIT_MAX_SEATS);
+
+	d->seats_count = d->config.seats.count ? d->config.seats.count : 1;
+
+	for (i = 0; i < d->seats_count; i++) {
+		seat = &d->seats[i];
+		seat->display = d;
+		seat->index = i;
+
+		if (d->config.seats.count && d->config.seats.caps[i])
+			seat->caps = d->config.seats.caps[i] & all;
+		else
+			seat->caps = all;
+
+		seat->caps &= d->config.resources;
+
+		seat->global = wl_global_create(d->display, &wl_seat_interface,
+						wl_seat_interface.version,
+						seat, seat_bind);
+		assertf(seat->global, "Failed creating global for seat %u", i);
+	}
+
+	d->globals.wl_seat = d->seats[0].global;
+}
 
 /* create globals in display according to configuration */
 static void
 display_create_globals(struct wit_display *d)
 {
+	struct wl_global *global;
+	uint32_t i;
+
 	assert(d);
 
+	/* globals are destroyed by wl_display_destroy() */
+	for (i = 0; i < d->config.synthetic.count; i++) {
+		global = wl_global_create(d->display, &wit_synthetic_interface,
+					  wit_synthetic_interface.version,
+					  d, synthetic_bind);
+		assertf(global, "Failed creating synthetic global");
+	}
+
 	if (d->config.globals == 0)
 		return;
 
-	if (d->config.globals & CONF_SEAT) {
-		d->globals.wl_seat =
-			wl_global_create(d->display, &wl_seat_interface,
-					 wl_seat_interface.version,
-					 d, seat_bind);
-		assertf(d->globals.wl_seat, "Failed creating global for seat");
-	}
+	if (d->config.globals & CONF_SEAT)
+		display_create_seats(d);
 
 	if (d->config.globals & CONF_COMPOSITOR) {
 		d->globals.wl_compositor =
@@ -1,22 +1,79 @@
 #ifndef __WIT_SERVER_H__
 #define __WIT_SERVER_H__
 
+#include <time.h>
 #include <unistd.h>
+#include <wayland-server.h>
 
 #include "configuration.h"
 #include "events.h"
+#include "checksum.h"
+#include "generator.h"
+#include "keymap.h"
+#include "probe.h"
+#include "snapshot.h"
 
 /* container for wl_surface (it is stored in wl_list)*/
 struct wit_surface {
 	struct wl_list link;
 
-	struct wl_resource *resource;
+	struct wit_display *display;
+	struct wl_resource *resource;	/* user data of resource is this */
 	uint32_t id;
+
+	/* buffer attached by wl_surface.attach and not commited yet */
+	struct wl_resource *pending_buffer;
+	struct wl_listener pending_buffer_destroy;
+
+	/* wl_callbacks from wl_surface.frame, done is sent upon commit */
+	struct wl_array frame_callbacks;
+
+	/* checksums (uint32_t) of commited shm buffers, the oldest first */
+	struct wl_array checksums;
+};
+
+/* result of stress mode (see CONF_OPT_STRESS) */
+struct wit_stress_report {
+	uint32_t emitted;		/* how many events were posted */
+	uint32_t steps;			/* steps finished with client connected */
+	uint32_t flush_eagain;		/* flushes that couldn't write all data */
+	uint32_t max_sustained_rate;	/* highest rate without EAGAIN */
+	uint32_t saturated_rate;	/* first rate with EAGAIN (0 = none) */
+	uint32_t broken_rate;		/* rate when client got disconnected
+					   (0 = client survived) */
+};
+
+/**
+ * Seat of display
+ *
+ * Seat 0 is the default seat, its global and resources are mirrored in
+ * wit_display's globals.wl_seat and resources.{seat, pointer, keyboard,
+ * touch}, so code that knows only one seat keeps working.
+ */
+struct wit_seat {
+	struct wit_display *display;
+	uint32_t index;
+	uint32_t caps;		/* CONF_POINTER | CONF_KEYBOARD | CONF_TOUCH */
+
+	struct wl_global *global;
+
+	struct {
+		struct wl_resource *seat;
+		struct wl_resource *pointer;
+		struct wl_resource *keyboard;
+		struct wl_resource *touch;
+	} resources;
 };
 
 /* ===
  *  Compositor
    === */
+/* item of heap used for merging eventarrays */
+struct wit_merge_item {
+	struct wit_eventarray *ea;
+	unsigned int order;	/* position in order of adding */
+};
+
 struct wit_display {
 	struct wl_display *display;
 	struct wl_client *client;
@@ -43,6 +100,9 @@ struct wit_display {
 	/* list of wit_surfaces */
 	struct wl_list surfaces;
 
+	struct wit_seat seats[WIT_MAX_SEATS];
+	uint32_t seats_count;
+
 	int client_sock[2];
 	struct wl_event_source *sigchld;
 	struct wl_event_source *sigusr1;
@@ -60,10 +120,61 @@ struct wit_display {
 
 	struct wit_eventarray *events;
 
+	/* eventarrays added while d->events is set (struct wit_eventarray *),
+	 * their events are emitted merged with d->events by time */
+	struct wl_array streams;
+
+	/* min-heap of eventarrays with events left, ordered by time of
+	 * the next event (k-way merge of d->events and d->streams) */
+	struct {
+		struct wit_merge_item *items;
+		unsigned int count;
+		unsigned int size;
+	} merge;
+
+	/* generator of events, takes precedence over events */
+	struct wit_generator *generator;
+
 	struct wit_config config;
 
+	/* directory where commited buffers are stored (NULL = don't store) */
+	char *snapshot_dir;
+
 	/* sigusr1 sets this when action from display is required */
 	int request;
+
+	/* timer used for injecting latency (see wit_config.latency) */
+	struct {
+		int fd;
+		struct wl_event_source *source;
+		int expired;
+		unsigned int seed;
+
+		/* when can be next event emitted (max_event_rate) */
+		struct timespec next_event;
+	} latency;
+
+	/* emitting of timed events (see wit_eventarray_add_timed()) */
+	struct {
+		int fd;
+		struct wl_event_source *source;
+		struct timespec start;
+		int left;	/* how many events are still to be emitted */
+	} schedule;
+
+	/* sets client to NULL when client is destroyed */
+	struct wl_listener client_destroy;
+
+	struct wit_stress_report stress;
+
+	/* end-to-end latency of events (CONF_OPT_PROBE) */
+	struct wit_probe *probe;
+
+	/* keymap shared by all keyboards (CONF_OPT_KEYMAP) */
+	struct {
+		int keymap_fd;
+		uint32_t keymap_size;
+	} keyboard;
 };
 
 /**
@@ -196,12 +307,43 @@ wit_display_add_user_func(struct wit_display *d,
  * calls wit_client_ask_for_events() and display answers by calling
  * wit_display_emit_events() (on the same position in code of course)
  *
+ * Display can have more eventarrays at once (e. g. one per seat or
+ * device). Events from all of them are emitted as one stream merged by
+ * time of events (see wit_eventarray_add_timed()). Events with the same
+ * time are emitted in order in which their eventarrays were added, so
+ * untimed eventarrays are emitted one after another. Display takes
+ * ownership of all the eventarrays.
+ *
  * @param d    display's struct
  * @param e    eventarray
  */
 void
 wit_display_add_events(struct wit_display *d, struct wit_eventarray *e);
 
+/**
+ * Assign generator to be used for emitting events
+ *
+ * While display has a generator, wit_client_ask_for_events(client, n)
+ * emits n steps of the generator (0 means until the generator is
+ * exhausted) instead of events from eventarray. Exhausted generator is
+ * destroyed and display returns to eventarray.
+ *
+ * @param d    display's struct
+ * @param g    generator (display takes ownership)
+ */
+void
+wit_display_add_generator(struct wit_display *d, struct wit_generator *g);
+
+/**
+ * Get seat of display
+ *
+ * @param d      display
+ * @param index  index of the seat (0 is the default seat)
+ * @return       seat (asserts that the seat exists)
+ */
+struct wit_seat *
+wit_display_get_seat(struct wit_display *d, uint32_t index);
+
 /**
  * Process request from client
  *
@@ -250,4 +392,85 @@ wit_display_process_request(struct wit_display *d);
 void
 wit_display_recieve_eventarray(struct wit_display *d);
 
+/**
+ * Find surface by id of its wl_surface resource
+ *
+ * @param d    display's struct
+ * @param id   id of wl_surface
+ * @return     wit_surface or NULL when there's no such surface
+ */
+struct wit_surface *
+wit_display_get_surface(struct wit_display *d, uint32_t id);
+
+/**
+ * Get checksum of the last shm buffer commited on surface
+ *
+ * Display computes checksum (see wit_shm_checksum()) of each shm buffer
+ * that is commited on a surface and saves it into surface's checksums
+ * array. Client can compute the checksum of its buffer too and send it
+ * to display, so that rendering can be verified without sending
+ * whole buffer.
+ *
+ * Usual usage is:
+ * == CLIENT ==
+ * ...
+ * wl_surface_attach(surface, buffer, 0, 0);
+ * wl_surface_commit(surface);
+ * wl_display_roundtrip(display);
+ *
+ * checksum = wit_shm_checksum(pixels, width, height, stride, format);
+ * wit_client_send_data(client, &checksum, sizeof checksum);
+ *
+ * == DISPLAY ==
+ * ...
+ * wit_display_recieve_data(display);
+ * s = wit_display_get_surface(display, id);
+ * assert(wit_surface_get_checksum(s) == *((uint32_t *) display->data));
+ *
+ * @param s    surface
+ * @return     checksum (aborts when nothing has been commited)
+ */
+uint32_t
+wit_surface_get_checksum(struct wit_surface *s);
+
+/**
+ * Store commited buffers into snapshot store
+ *
+ * When set, contents of each shm buffer commited on any surface is saved
+ * into directory dir (see wit_snapshot_store()). Buffers with the same
+ * contents are saved only once. Directory is created if it doesn't exist.
+ *
+ * @param d    display's struct
+ * @param dir  path to directory, NULL stops storing
+ */
+void
+wit_display_set_snapshot_dir(struct wit_display *d, const char *dir);
+
+/**
+ * Compare last buffer commited on surface with golden image
+ *
+ * The buffer is taken from snapshot store, so the store must be set
+ * (wit_display_set_snapshot_dir()) before the buffer is commited. Golden
+ * image is a snapshot file (e.g. a snapshot from the store that has been
+ * checked by human and copied aside).
+ *
+ * Usual usage is:
+ *
+ * wit_display_set_snapshot_dir(d, "snapshots");
+ * ... let client commit a buffer ...
+ * s = wit_display_get_surface(d, id);
+ * assert(wit_display_compare_golden(d, s, "golden/button.wsnap", 2) == 0);
+ *
+ * @param d          display's struct
+ * @param s          surface
+ * @param golden     path to golden image
+ * @param tolerance  maximal allowed difference of channel value
+ * @return           number of pixels that differ more than tolerance or
+ *                   WIT_SNAPSHOT_INCOMPARABLE when images have different
+ *                   size or can not be loaded
+ */
+size_t
+wit_display_compare_golden(struct wit_display *d, struct wit_surface *s,
+			   const char *golden, uint8_t tolerance);
+
 #endif /* __WIT_SERVER_H__ */
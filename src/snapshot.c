@@ -0,0 +1,305 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "checksum.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "WITS"
+#define SNAPSHOT_VERSION 1
+
+/* header of snapshot file, it is followed by width * height pixels */
+struct snapshot_header {
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	uint32_t format;
+	uint32_t checksum;
+};
+
+static int
+snapshot_format_supported(uint32_t format)
+{
+	return format == WL_SHM_FORMAT_ARGB8888
+		|| format == WL_SHM_FORMAT_XRGB8888;
+}
+
+int
+wit_snapshot_save(const char *path, const void *data, int32_t width,
+		  int32_t height, int32_t stride, uint32_t format)
+{
+	struct snapshot_header header;
+	const char *row = data;
+	int32_t y;
+	FILE *f;
+
+	assert(path && data);
+
+	if (!snapshot_format_supported(format)) {
+		dbg("Snapshot: unsupported format %u\n", format);
+		return -1;
+	}
+
+	assertf(width > 0 && height > 0 && stride >= width * 4,
+		"Wrong dimensions of buffer (%dx%d, stride %d)",
+		width, height, stride);
+
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+	header.version = SNAPSHOT_VERSION;
+	header.width = width;
+	header.height = height;
+	header.format = format;
+	header.checksum = wit_shm_checksum(data, width, height,
+					   stride, format);
+
+	f = fopen(path, "w");
+	if (!f) {
+		dbg("Snapshot: opening '%s' failed: %m\n", path);
+		return -1;
+	}
+
+	if (fwrite(&header, sizeof header, 1, f) != 1)
+		goto err;
+
+	/* store pixels without padding */
+	for (y = 0; y < height; y++) {
+		if (fwrite(row, 4, width, f) != (size_t) width)
+			goto err;
+
+		row += stride;
+	}
+
+	if (fclose(f) != 0) {
+		dbg("Snapshot: closing '%s' failed: %m\n", path);
+		return -1;
+	}
+
+	return 0;
+
+err:
+	dbg("Snapshot: writing '%s' failed\n", path);
+	fclose(f);
+	return -1;
+}
+
+struct wit_snapshot *
+wit_snapshot_load(const char *path)
+{
+	struct snapshot_header header;
+	struct wit_snapshot *s;
+	size_t n;
+	FILE *f;
+
+	assert(path);
+
+	f = fopen(path, "r");
+	if (!f) {
+		dbg("Snapshot: opening '%s' failed: %m\n", path);
+		return NULL;
+	}
+
+	if (fread(&header, sizeof header, 1, f) != 1
+	    || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof header.magic) != 0
+	    || header.version != SNAPSHOT_VERSION
+	    || header.width <= 0 || header.height <= 0
+	    || !snapshot_format_supported(header.format)) {
+		dbg("Snapshot: '%s' is not a snapshot\n", path);
+		fclose(f);
+		return NULL;
+	}
+
+	s = malloc(sizeof *s);
+	assert(s && "Out of memory");
+
+	s->width = header.width;
+	s->height = header.height;
+	s->format = header.format;
+	s->checksum = header.checksum;
+
+	n = (size_t) s->width * s->height;
+	s->pixels = malloc(n * 4);
+	assert(s->pixels && "Out of memory");
+
+	if (fread(s->pixels, 4, n, f) != n) {
+		dbg("Snapshot: '%s' is truncated\n", path);
+		wit_snapshot_free(s);
+		fclose(f);
+		return NULL;
+	}
+
+	fclose(f);
+	return s;
+}
+
+void
+wit_snapshot_free(struct wit_snapshot *s)
+{
+	assert(s);
+
+	free(s->pixels);
+	free(s);
+}
+
+static void
+store_path(char *path, size_t size, const char *dir, uint32_t checksum)
+{
+	int stat = snprintf(path, size, "%s/%08x.wsnap", dir, checksum);
+	assertf(stat > 0 && (size_t) stat < size,
+		"Path to snapshot is too long");
+}
+
+int
+wit_snapshot_store(const char *dir, uint32_t checksum, const void *data,
+		   int32_t width, int32_t height, int32_t stride,
+		   uint32_t format)
+{
+	char path[PATH_MAX];
+
+	assert(dir);
+	store_path(path, sizeof path, dir, checksum);
+
+	/* deduplicate by checksum */
+	if (access(path, F_OK) == 0)
+		return 0;
+
+	return wit_snapshot_save(path, data, width, height, stride, format);
+}
+
+struct wit_snapshot *
+wit_snapshot_store_load(const char *dir, uint32_t checksum)
+{
+	char path[PATH_MAX];
+
+	assert(dir);
+	store_path(path, sizeof path, dir, checksum);
+
+	return wit_snapshot_load(path);
+}
+
+static inline int
+pixel_differs(uint32_t a, uint32_t b, uint8_t tolerance, uint32_t mask)
+{
+	int i, d;
+
+	a &= mask;
+	b &= mask;
+
+	for (i = 0; i < 32; i += 8) {
+		d = (int) ((a >> i) & 0xff) - (int) ((b >> i) & 0xff);
+		if (d > tolerance || -d > tolerance)
+			return 1;
+	}
+
+	return 0;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* compare 4 pixels at once, returns how many pixels
+ * have been compared (multiple of 4) */
+static size_t
+pixels_diff_sse2(const uint32_t *a, const uint32_t *b, size_t n,
+		 uint8_t tolerance, uint32_t mask, size_t *count)
+{
+	size_t i;
+	int within;
+	__m128i va, vb, diff;
+	const __m128i vtol = _mm_set1_epi8((char) tolerance);
+	const __m128i vmask = _mm_set1_epi32((int) mask);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		va = _mm_loadu_si128((const __m128i *) (a + i));
+		vb = _mm_loadu_si128((const __m128i *) (b + i));
+
+		/* |a - b| per channel */
+		diff = _mm_or_si128(_mm_subs_epu8(va, vb),
+				    _mm_subs_epu8(vb, va));
+		diff = _mm_and_si128(diff, vmask);
+
+		/* non-zero channels are those over tolerance */
+		diff = _mm_subs_epu8(diff, vtol);
+		within = _mm_movemask_ps(_mm_castsi128_ps(
+					_mm_cmpeq_epi32(diff, zero)));
+
+		*count += 4 - __builtin_popcount(within);
+	}
+
+	return i;
+}
+#endif /* __SSE2__ */
+
+size_t
+wit_pixels_diff(const uint32_t *a, const uint32_t *b, size_t n,
+		uint8_t tolerance, int ignore_alpha)
+{
+	size_t i = 0, count = 0;
+	uint32_t mask = ignore_alpha ? 0x00ffffff : 0xffffffff;
+
+	assert(a && b);
+
+#ifdef __SSE2__
+	i = pixels_diff_sse2(a, b, n, tolerance, mask, &count);
+#endif
+
+	for (; i < n; i++)
+		count += pixel_differs(a[i], b[i], tolerance, mask);
+
+	return count;
+}
+
+size_t
+wit_snapshot_compare(const struct wit_snapshot *a,
+		     const struct wit_snapshot *b, uint8_t tolerance)
+{
+	int ignore_alpha;
+
+	assert(a && b);
+
+	if (a->width != b->width || a->height != b->height) {
+		dbg("Snapshots have different size (%dx%d and %dx%d)\n",
+		    a->width, a->height, b->width, b->height);
+		return WIT_SNAPSHOT_INCOMPARABLE;
+	}
+
+	/* exactly the same pixels, no need to go through them */
+	if (a->checksum == b->checksum && tolerance == 0
+	    && a->format == b->format
+	    && memcmp(a->pixels, b->pixels, (size_t) a->width * a->height * 4) == 0)
+		return 0;
+
+	ignore_alpha = a->format == WL_SHM_FORMAT_XRGB8888
+			|| b->format == WL_SHM_FORMAT_XRGB8888;
+
+	return wit_pixels_diff(a->pixels, b->pixels,
+			       (size_t) a->width * a->height,
+			       tolerance, ignore_alpha);
+}
@@ -0,0 +1,108 @@
+#ifndef __WIT_SNAPSHOT_H__
+#define __WIT_SNAPSHOT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Snapshot of shm buffer contents
+ *
+ * Snapshots are stored in files (usually named by checksum of the pixels,
+ * see wit_display_set_snapshot_dir()). Only formats with 32-bit pixels
+ * (ARGB8888 and XRGB8888) are supported and pixels are stored without
+ * padding, so stride is always width * 4.
+ */
+struct wit_snapshot {
+	int32_t width;
+	int32_t height;
+	uint32_t format;	/* enum wl_shm_format */
+	uint32_t checksum;	/* wit_shm_checksum() of pixels */
+
+	uint32_t *pixels;
+};
+
+/* returned by comparing functions when images can not be compared */
+#define WIT_SNAPSHOT_INCOMPARABLE ((size_t) -1)
+
+/**
+ * Save pixels into snapshot file
+ *
+ * @param path    path to the file
+ * @param data    pixels
+ * @param width   width of image in pixels
+ * @param height  height of image in pixels
+ * @param stride  length of one row in bytes
+ * @param format  WL_SHM_FORMAT_ARGB8888 or WL_SHM_FORMAT_XRGB8888
+ * @return        0 on success, -1 on error
+ */
+int
+wit_snapshot_save(const char *path, const void *data, int32_t width,
+		  int32_t height, int32_t stride, uint32_t format);
+
+/**
+ * Load snapshot from file
+ *
+ * @param path    path to the file
+ * @return        snapshot or NULL on error
+ */
+struct wit_snapshot *
+wit_snapshot_load(const char *path);
+
+void
+wit_snapshot_free(struct wit_snapshot *s);
+
+/**
+ * Save pixels into snapshot store
+ *
+ * Snapshot store is a directory where snapshots are saved under name
+ * given by their checksum (CHECKSUM.wsnap), so the same contents are
+ * stored only once.
+ *
+ * @param dir       directory of the store
+ * @param checksum  wit_shm_checksum() of the pixels
+ * @return          0 on success (or when the snapshot is already stored),
+ *                  -1 on error
+ */
+int
+wit_snapshot_store(const char *dir, uint32_t checksum, const void *data,
+		   int32_t width, int32_t height, int32_t stride,
+		   uint32_t format);
+
+/**
+ * Load snapshot with given checksum from snapshot store
+ *
+ * @return   snapshot or NULL when there's no such snapshot
+ */
+struct wit_snapshot *
+wit_snapshot_store_load(const char *dir, uint32_t checksum);
+
+/**
+ * Count pixels that differ more than tolerance
+ *
+ * Pixels are compared per channel, so pixel differs when difference
+ * in any channel is greater than tolerance.
+ *
+ * @param a             first array of pixels
+ * @param b             second array of pixels
+ * @param n             number of pixels
+ * @param tolerance     maximal allowed difference in one channel
+ * @param ignore_alpha  don't compare alpha channel (XRGB formats)
+ * @return              number of different pixels
+ */
+size_t
+wit_pixels_diff(const uint32_t *a, const uint32_t *b, size_t n,
+		uint8_t tolerance, int ignore_alpha);
+
+/**
+ * Compare two snapshots
+ *
+ * Alpha is ignored when any of the snapshots is in XRGB8888 format.
+ *
+ * @return   number of different pixels or WIT_SNAPSHOT_INCOMPARABLE
+ *           when snapshots have different size
+ */
+size_t
+wit_snapshot_compare(const struct wit_snapshot *a,
+		     const struct wit_snapshot *b, uint8_t tolerance);
+
+#endif /* __WIT_SNAPSHOT_H__ */
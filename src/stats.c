@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "stats.h"
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+uint64_t
+wit_percentile(const uint64_t *sorted, size_t n, double p)
+{
+	size_t rank;
+
+	if (n == 0)
+		return 0;
+
+	/* nearest rank: the smallest value that is greater or equal
+	 * than p percent of samples */
+	rank = (size_t) ceil(p / 100.0 * n);
+	if (rank == 0)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+
+	return sorted[rank - 1];
+}
+
+void
+wit_stats_compute(struct wit_stats *s, uint64_t *samples, size_t n)
+{
+	double sum = 0, sq = 0, d;
+	size_t i;
+
+	memset(s, 0, sizeof *s);
+	s->count = n;
+
+	if (n == 0)
+		return;
+
+	qsort(samples, n, sizeof *samples, compare_u64);
+
+	s->min = samples[0];
+	s->max = samples[n - 1];
+	s->median = wit_percentile(samples, n, 50);
+	s->p90 = wit_percentile(samples, n, 90);
+	s->p99 = wit_percentile(samples, n, 99);
+
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+	s->mean = sum / n;
+
+	for (i = 0; i < n; i++) {
+		d = samples[i] - s->mean;
+		sq += d * d;
+	}
+
+	/* sample standard deviation */
+	s->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+}
+
+/* continued fraction of regularized incomplete beta function
+ * (modified Lentz's method) */
+static double
+incomplete_beta_cf(double a, double b, double x)
+{
+	const double eps = 1e-12, tiny = 1e-300;
+	double c = 1.0, d, h, num, delta;
+	int m;
+
+	d = 1.0 - (a + b) * x / (a + 1.0);
+	if (fabs(d) < tiny)
+		d = tiny;
+	d = 1.0 / d;
+	h = d;
+
+	for (m = 1; m <= 300; m++) {
+		/* even step */
+		num = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+		d = 1.0 + num * d;
+		if (fabs(d) < tiny)
+			d = tiny;
+		c = 1.0 + num / c;
+		if (fabs(c) < tiny)
+			c = tiny;
+		d = 1.0 / d;
+		h *= d * c;
+
+		/* odd step */
+		num = -(a + m) * (a + b + m) * x
+		      / ((a + 2 * m) * (a + 2 * m + 1));
+		d = 1.0 + num * d;
+		if (fabs(d) < tiny)
+			d = tiny;
+		c = 1.0 + num / c;
+		if (fabs(c) < tiny)
+			c = tiny;
+		d = 1.0 / d;
+		delta = d * c;
+		h *= delta;
+
+		if (fabs(delta - 1.0) < eps)
+			break;
+	}
+
+	return h;
+}
+
+/* regularized incomplete beta function I_x(a, b) */
+static double
+incomplete_beta(double a, double b, double x)
+{
+	double front;
+
+	if (x <= 0)
+		return 0;
+	if (x >= 1)
+		return 1;
+
+	front = exp(lgamma(a + b) - lgamma(a) - lgamma(b)
+		    + a * log(x) + b * log(1 - x));
+
+	/* the continued fraction converges fast only for small x */
+	if (x < (a + 1) / (a + b + 2))
+		return front * incomplete_beta_cf(a, b, x) / a;
+
+	return 1 - front * incomplete_beta_cf(b, a, 1 - x) / b;
+}
+
+int
+wit_welch_test(struct wit_welch *w, double mean_a, double var_a, size_t n_a,
+	       double mean_b, double var_b, size_t n_b)
+{
+	double sa, sb, se;
+
+	if (n_a == 0 || n_b == 0 || n_a + n_b < 3)
+		return -1;
+
+	if (n_a == 1) {
+		/* new value against distribution of b */
+		se = var_b * (1.0 + 1.0 / n_b);
+		w->df = n_b - 1;
+	} else if (n_b == 1) {
+		se = var_a * (1.0 + 1.0 / n_a);
+		w->df = n_a - 1;
+	} else {
+		sa = var_a / n_a;
+		sb = var_b / n_b;
+		se = sa + sb;
+		/* Welch-Satterthwaite equation */
+		w->df = se > 0 ? se * se / (sa * sa / (n_a - 1)
+					    + sb * sb / (n_b - 1))
+			       : n_a + n_b - 2;
+	}
+
+	if (se <= 0) {
+		/* no variance, the means either are equal or not */
+		w->t = mean_b == mean_a ? 0
+		       : mean_b > mean_a ? INFINITY : -INFINITY;
+		w->p = mean_b == mean_a ? 1 : 0;
+		return 0;
+	}
+
+	w->t = (mean_b - mean_a) / sqrt(se);
+	w->p = incomplete_beta(w->df / 2, 0.5, w->df / (w->df + w->t * w->t));
+
+	return 0;
+}
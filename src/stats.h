@@ -0,0 +1,76 @@
+#ifndef __WIT_STATS_H__
+#define __WIT_STATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Summary of samples (e. g. latencies in nanoseconds)
+ */
+struct wit_stats {
+	size_t count;
+
+	uint64_t min;
+	uint64_t max;
+	uint64_t median;
+	uint64_t p90;
+	uint64_t p99;
+
+	double mean;
+	double stddev;
+};
+
+/**
+ * Get percentile of sorted samples (nearest-rank method)
+ *
+ * @param sorted   samples sorted in ascending order
+ * @param n        number of samples
+ * @param p        percentile (0 - 100)
+ * @return         value of the percentile, 0 when there are no samples
+ */
+uint64_t
+wit_percentile(const uint64_t *sorted, size_t n, double p);
+
+/**
+ * Compute summary of samples
+ *
+ * Samples are sorted in place.
+ *
+ * @param s        where to store the summary
+ * @param samples  samples
+ * @param n        number of samples
+ */
+void
+wit_stats_compute(struct wit_stats *s, uint64_t *samples, size_t n);
+
+/**
+ * Result of Welch's t-test
+ */
+struct wit_welch {
+	double t;	/* positive when b has greater mean than a */
+	double df;	/* degrees of freedom */
+	double p;	/* two-sided p-value */
+};
+
+/**
+ * Welch's t-test: do two samples (with possibly different variances)
+ * have different means?
+ *
+ * When one of the samples has only one value, it is tested whether the
+ * value comes from distribution of the other sample (variance of the
+ * other sample is used for both).
+ *
+ * @param w       where to store the result
+ * @param mean_a  mean of the first sample
+ * @param var_a   sample variance of the first sample
+ * @param n_a     size of the first sample
+ * @param mean_b  mean of the second sample
+ * @param var_b   sample variance of the second sample
+ * @param n_b     size of the second sample
+ * @return        0 on success, -1 when samples are too small
+ */
+int
+wit_welch_test(struct wit_welch *w, double mean_a, double var_a, size_t n_a,
+	       double mean_b, double var_b, size_t n_b);
+
+#endif /* __WIT_STATS_H__ */
@@ -0,0 +1,206 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server.h>
+
+#include "wit-global.h"
+#include "wit-assert.h"
+#include "server.h"
+#include "generator.h"
+
+#define MAX_FINGERS 10
+
+struct touch_generator {
+	struct wit_generator base;
+	struct wit_touch_gesture gesture;
+
+	uint32_t step;		/* steps done */
+	int steps;		/* steps left */
+
+	int started;
+	uint32_t start_time;	/* ms */
+
+	/* surface that is touched */
+	struct wl_resource *surface;
+	struct wl_listener surface_destroy;
+};
+
+static uint32_t
+time_msec(void)
+{
+	struct timespec tp;
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+struct wit_point
+wit_touch_gesture_point(const struct wit_touch_gesture *gesture,
+			uint32_t finger, uint32_t sample)
+{
+	struct wit_point p;
+	double t, angle, radius;
+
+	assert(finger < gesture->fingers);
+
+	/* progress of the gesture in <0, 1> */
+	t = gesture->samples ? (double) sample / gesture->samples : 0.0;
+
+	angle = 2 * M_PI * finger / gesture->fingers;
+	radius = gesture->radius;
+	p = gesture->center;
+
+	switch (gesture->type) {
+		case WIT_GESTURE_SWIPE:
+			p.x += gesture->distance * t;
+			break;
+		case WIT_GESTURE_PINCH:
+			radius += gesture->distance * t;
+			break;
+		case WIT_GESTURE_ROTATE:
+			angle += gesture->distance * t;
+			break;
+		default:
+			assertf(0, "Unsupported gesture (%d)", gesture->type);
+	}
+
+	p.x += radius * cos(angle);
+	p.y += radius * sin(angle);
+
+	return p;
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct touch_generator *tg
+		= wl_container_of(listener, tg, surface_destroy);
+
+	tg->surface = NULL;
+}
+
+static void
+start(struct touch_generator *tg, struct wit_display *d)
+{
+	assertf(d->resources.surface, "Touch generator needs surface");
+
+	tg->started = 1;
+	tg->start_time = time_msec();
+
+	tg->surface = d->resources.surface;
+	tg->surface_destroy.notify = handle_surface_destroy;
+	wl_resource_add_destroy_listener(tg->surface, &tg->surface_destroy);
+}
+
+static int
+touch_generator_emit_one(struct wit_generator *g, struct wit_display *d)
+{
+	struct touch_generator *tg = (struct touch_generator *) g;
+	struct wl_resource *touch
+		= wit_display_get_seat(d, g->seat)->resources.touch;
+	struct wit_touch_gesture *ges = &tg->gesture;
+	struct wit_point p;
+	uint32_t time, i;
+
+	assertf(touch, "Touch generator needs touch resource");
+	assertf(tg->steps > 0, "Touch generator is exhausted");
+
+	if (!tg->started)
+		start(tg, d);
+
+	time = tg->start_time + (uint64_t) tg->step * 1000 / g->rate;
+
+	if (tg->step == 0) {
+		assertf(tg->surface, "Touched surface was destroyed");
+
+		for (i = 0; i < ges->fingers; i++) {
+			p = wit_touch_gesture_point(ges, i, 0);
+			wl_touch_send_down(touch,
+					   wl_display_next_serial(d->display),
+					   time, tg->surface, i,
+					   wl_fixed_from_double(p.x),
+					   wl_fixed_from_double(p.y));
+		}
+	} else if (tg->steps > 1) {
+		for (i = 0; i < ges->fingers; i++) {
+			p = wit_touch_gesture_point(ges, i, tg->step);
+			wl_touch_send_motion(touch, time, i,
+					     wl_fixed_from_double(p.x),
+					     wl_fixed_from_double(p.y));
+		}
+	} else if (ges->cancel) {
+		/* cancel is not part of any frame */
+		wl_touch_send_cancel(touch);
+		tg->step++;
+		return --tg->steps;
+	} else {
+		for (i = 0; i < ges->fingers; i++)
+			wl_touch_send_up(touch,
+					 wl_display_next_serial(d->display),
+					 time, i);
+	}
+
+	wl_touch_send_frame(touch);
+
+	tg->step++;
+	return --tg->steps;
+}
+
+static void
+touch_generator_destroy(struct wit_generator *g)
+{
+	struct touch_generator *tg = (struct touch_generator *) g;
+
+	if (tg->surface)
+		wl_list_remove(&tg->surface_destroy.link);
+
+	free(tg);
+}
+
+struct wit_generator *
+wit_touch_generator_create(const struct wit_touch_gesture *gesture)
+{
+	struct touch_generator *tg;
+
+	assert(gesture);
+	assertf(gesture->fingers > 0 && gesture->fingers <= MAX_FINGERS,
+		"Wrong number of fingers (%u)", gesture->fingers);
+
+	tg = calloc(1, sizeof *tg);
+	assert(tg && "Out of memory");
+
+	tg->gesture = *gesture;
+	if (tg->gesture.rate == 0)
+		tg->gesture.rate = 240;
+
+	/* down, motion, up (or cancel) */
+	tg->steps = gesture->samples + 2;
+
+	tg->base.emit_one = touch_generator_emit_one;
+	tg->base.destroy = touch_generator_destroy;
+	tg->base.rate = tg->gesture.rate;
+
+	return &tg->base;
+}
@@ -18,8 +18,23 @@
 		}								\
 	} while (0)
 
+/* debugging output can be turned off by WIT_NO_DBG environment variable
+ * (benchmarks do so), the variable is read only once */
+static inline int
+wit_dbg_enabled(void)
+{
+	static int enabled = -1;
+
+	if (enabled == -1)
+		enabled = getenv("WIT_NO_DBG") == NULL;
+
+	return enabled;
+}
+
 #define dbg(...) 								\
 	do {									\
+		if (!wit_dbg_enabled())						\
+			break;							\
 		fprintf(stderr, "[%d | %s in %s: %d] ", getpid(),		\
 				__FUNCTION__, __FILE__, __LINE__);		\
 		fprintf(stderr,	__VA_ARGS__);					\
@@ -21,6 +21,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <wayland-client.h>
@@ -107,6 +108,77 @@ const struct wl_seat_listener seat_default_listener = {
 	seat_handle_name
 };
 
+static void
+extra_seat_handle_caps(void *data, struct wl_seat *seat,
+		       enum wl_seat_capability caps)
+{
+	struct wit_client_seat *s = data;
+	struct wit_client *cl = s->client;
+
+	if ((caps & WL_SEAT_CAPABILITY_POINTER) && !s->pointer) {
+		s->pointer = (struct wl_proxy *) wl_seat_get_pointer(seat);
+		assertf(s->pointer, "Got no pointer from seat");
+
+		if (cl->pointer.listener)
+			wl_pointer_add_listener(
+				(struct wl_pointer *) s->pointer,
+				(struct wl_pointer_listener *) cl->pointer.listener,
+				cl);
+	}
+
+	if ((caps & WL_SEAT_CAPABILITY_KEYBOARD) && !s->keyboard) {
+		s->keyboard = (struct wl_proxy *) wl_seat_get_keyboard(seat);
+		assertf(s->keyboard, "Got no keyboard from seat");
+
+		if (cl->keyboard.listener)
+			wl_keyboard_add_listener(
+				(struct wl_keyboard *) s->keyboard,
+				(struct wl_keyboard_listener *) cl->keyboard.listener,
+				cl);
+	}
+
+	if ((caps & WL_SEAT_CAPABILITY_TOUCH) && !s->touch) {
+		s->touch = (struct wl_proxy *) wl_seat_get_touch(seat);
+		assertf(s->touch, "Got no touch from seat");
+
+		if (cl->touch.listener)
+			wl_touch_add_listener(
+				(struct wl_touch *) s->touch,
+				(struct wl_touch_listener *) cl->touch.listener,
+				cl);
+	}
+}
+
+static void
+extra_seat_handle_name(void *data, struct wl_seat *wl_seat, const char *name)
+{
+}
+
+static const struct wl_seat_listener extra_seat_listener = {
+	extra_seat_handle_caps,
+	extra_seat_handle_name
+};
+
+static void
+client_add_seat(struct wit_client *cl, struct wl_registry *registry,
+		uint32_t id, uint32_t version)
+{
+	struct wit_client_seat **s;
+
+	s = wl_array_add(&cl->seats, sizeof *s);
+	assert(s && "Out of memory");
+
+	*s = calloc(1, sizeof **s);
+	assert(*s && "Out of memory");
+
+	(*s)->client = cl;
+	(*s)->seat = wl_registry_bind(registry, id, &wl_seat_interface, version);
+	assertf((*s)->seat, "Binding to registry for seat failed");
+
+	wl_seat_add_listener((struct wl_seat *) (*s)->seat,
+			     &extra_seat_listener, *s);
+}
+
 /* -----------------------------------------------------------------------------
     Registry listener
    -------------------------------------------------------------------------- */
@@ -115,10 +187,12 @@ registry_handle_global(void *data, struct wl_registry *registry,
 		       uint32_t id, const char *interface, uint32_t version)
 {
 	struct wit_client *cl = data;
-	if (strcmp(interface, "wl_seat") == 0) {
-		if (cl->seat.proxy)
-			wl_seat_destroy((struct wl_seat *) cl->seat.proxy);
+	struct wl_proxy **p;
 
+	if (strcmp(interface, "wl_seat") == 0 && cl->seat.proxy) {
+		/* display has more seats */
+		client_add_seat(cl, registry, id, version);
+	} else if (strcmp(interface, "wl_seat") == 0) {
 		cl->seat.proxy = wl_registry_bind(registry, id,
 						  &wl_seat_interface, version);
 		assertf(cl->seat.proxy, "Binding to registry for seat failed");
@@ -144,12 +218,22 @@ registry_handle_global(void *data, struct wl_registry *registry,
 						 version);
 		assertf(cl->shm.proxy,
 			"Binding to registry for wl_shm failed");
+	} else if (strcmp(interface, "wit_synthetic") == 0) {
+		p = wl_array_add(&cl->synthetic, sizeof *p);
+		assert(p && "Out of memory");
+
+		*p = wl_registry_bind(registry, id, &wit_synthetic_interface,
+				      version);
+		assertf(*p, "Binding to registry for synthetic global failed");
 	} else if (strcmp(interface, "wl_display") == 0) {
 		return;
 	} else {
 		assertf(0, "Unknown interface!");
 	}
 
+	if (cl->batch_bind)
+		return;
+
 	wl_display_roundtrip(cl->display);
 	assertf(wl_display_get_error(cl->display) == 0,
 		"An error in display occured");
@@ -25,6 +25,12 @@
 #include "wit-global.h"
 #include "wit-assert.h"
 
+const struct wl_interface wit_synthetic_interface = {
+	"wit_synthetic", 1,
+	0, NULL,
+	0, NULL,
+};
+
 int
 asswrite(int fd, void *src, size_t size)
 {
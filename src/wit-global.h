@@ -38,7 +38,11 @@ enum side {
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #include <wayland-client-protocol.h>
 
-const struct wl_registry_listener registry_default_listener;
+extern const struct wl_registry_listener registry_default_listener;
+
+/* interface of synthetic globals (see wit_config.synthetic), objects of
+ * this interface have no requests nor events */
+extern const struct wl_interface wit_synthetic_interface;
 
 /* write with assert check */
 int
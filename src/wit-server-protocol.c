@@ -29,64 +29,164 @@
 /* -----------------------------------------------------------------------------
  *  Seat default implementation
  * -------------------------------------------------------------------------- */
+/* resources of the seat are forgotten once the client releases them */
+static void
+seat_input_resource_destroy(struct wl_resource *resource)
+{
+	struct wit_display *d = wl_resource_get_user_data(resource);
+	struct wit_seat *seat;
+	uint32_t i;
+
+	for (i = 0; i < d->seats_count; ++i) {
+		seat = &d->seats[i];
+
+		if (seat->resources.pointer == resource)
+			seat->resources.pointer = NULL;
+		if (seat->resources.keyboard == resource)
+			seat->resources.keyboard = NULL;
+		if (seat->resources.touch == resource)
+			seat->resources.touch = NULL;
+	}
+
+	if (d->resources.pointer == resource)
+		d->resources.pointer = NULL;
+	if (d->resources.keyboard == resource)
+		d->resources.keyboard = NULL;
+	if (d->resources.touch == resource)
+		d->resources.touch = NULL;
+}
+
+static void
+input_resource_release(struct wl_client *client, struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+/* the display has no cursor */
+static void
+pointer_set_cursor(struct wl_client *client, struct wl_resource *resource,
+		   uint32_t serial, struct wl_resource *surface,
+		   int32_t hotspot_x, int32_t hotspot_y)
+{
+}
+
+static const struct wl_pointer_interface pointer_implementation = {
+	pointer_set_cursor,
+	input_resource_release
+};
+
 static void
 seat_get_pointer(struct wl_client *client, struct wl_resource *resource,
 		 uint32_t id)
 {
 	struct wl_resource *res;
-	struct wit_display *d = wl_resource_get_user_data(resource);
-	assertf(d, "No user data in resource");
+	struct wit_seat *seat = wl_resource_get_user_data(resource);
+	assertf(seat, "No user data in resource");
+	struct wit_display *d = seat->display;
 
-	if (!(d->config.resources & CONF_POINTER)) {
+	if (!(seat->caps & CONF_POINTER)) {
 		dbg("Creating pointer resource suppressed\n");
 		return;
 	}
 
-	res = wl_resource_create(client, &wl_pointer_interface, 1, id);
+	res = wl_resource_create(client, &wl_pointer_interface,
+				 wl_resource_get_version(resource), id);
 	assertf(res, "Failed creating resource for pointer");
-	wl_resource_set_user_data(res, d);
+	wl_resource_set_implementation(res, &pointer_implementation, d,
+				       seat_input_resource_destroy);
+
+	seat->resources.pointer = res;
+	if (seat->index == 0)
+		d->resources.pointer = res;
+}
+
+static void
+keyboard_send_keymap(struct wit_display *d, struct wl_resource *keyboard)
+{
+	const char *keymap = d->config.keyboard.keymap;
+	int32_t rate = d->config.keyboard.repeat_rate;
+	int32_t delay = d->config.keyboard.repeat_delay;
+
+	if (d->keyboard.keymap_fd < 0) {
+		d->keyboard.keymap_fd
+			= wit_keymap_create_fd(keymap ? keymap : wit_default_keymap,
+					       &d->keyboard.keymap_size);
+		assertf(d->keyboard.keymap_fd >= 0, "Creating keymap failed");
+	}
+
+	wl_keyboard_send_keymap(keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1,
+				d->keyboard.keymap_fd, d->keyboard.keymap_size);
 
-	d->resources.pointer = res;
+#ifdef WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION
+	if (wl_resource_get_version(keyboard)
+	    >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
+		wl_keyboard_send_repeat_info(keyboard, rate ? rate : 25,
+					     delay ? delay : 600);
+#endif
+
+	wl_keyboard_send_modifiers(keyboard, wl_display_next_serial(d->display),
+				   0, 0, 0, 0);
 }
 
+static const struct wl_keyboard_interface keyboard_implementation = {
+	input_resource_release
+};
+
 static void
 seat_get_keyboard(struct wl_client *client, struct wl_resource *resource,
 		 uint32_t id)
 {
 	struct wl_resource *res;
-	struct wit_display *d = wl_resource_get_user_data(resource);
-	assertf(d, "No user data in resource");
+	struct wit_seat *seat = wl_resource_get_user_data(resource);
+	assertf(seat, "No user data in resource");
+	struct wit_display *d = seat->display;
 
-	if (!(d->config.resources & CONF_KEYBOARD)) {
+	if (!(seat->caps & CONF_KEYBOARD)) {
 		dbg("Creating keyboard resource suppressed\n");
 		return;
 	}
 
-	res = wl_resource_create(client, &wl_keyboard_interface, 1, id);
+	res = wl_resource_create(client, &wl_keyboard_interface,
+				 wl_resource_get_version(resource), id);
 	assertf(res, "Failed creating resource for keyboard");
-	wl_resource_set_user_data(res, d);
+	wl_resource_set_implementation(res, &keyboard_implementation, d,
+				       seat_input_resource_destroy);
 
-	d->resources.keyboard = res;
+	if (d->config.options & CONF_OPT_KEYMAP)
+		keyboard_send_keymap(d, res);
+
+	seat->resources.keyboard = res;
+	if (seat->index == 0)
+		d->resources.keyboard = res;
 }
 
+static const struct wl_touch_interface touch_implementation = {
+	input_resource_release
+};
+
 static void
 seat_get_touch(struct wl_client *client, struct wl_resource *resource,
 		 uint32_t id)
 {
 	struct wl_resource *res;
-	struct wit_display *d = wl_resource_get_user_data(resource);
-	assertf(d, "No user data in resource");
+	struct wit_seat *seat = wl_resource_get_user_data(resource);
+	assertf(seat, "No user data in resource");
+	struct wit_display *d = seat->display;
 
-	if (!(d->config.resources & CONF_TOUCH)) {
+	if (!(seat->caps & CONF_TOUCH)) {
 		dbg("Creating touch resource suppressed\n");
 		return;
 	}
 
-	res = wl_resource_create(client, &wl_touch_interface, 1, id);
+	res = wl_resource_create(client, &wl_touch_interface,
+				 wl_resource_get_version(resource), id);
 	assertf(res, "Failed creating resource for touch");
-	wl_resource_set_user_data(res, d);
+	wl_resource_set_implementation(res, &touch_implementation, d,
+				       seat_input_resource_destroy);
 
-	d->resources.touch = res;
+	seat->resources.touch = res;
+	if (seat->index == 0)
+		d->resources.touch = res;
 }
 
 const struct wl_seat_interface seat_default_implementation = {
@@ -95,11 +195,13 @@ const struct wl_seat_interface seat_default_implementation = {
 	seat_get_touch
 };
 
+/* data is wit_seat */
 void
 seat_bind(struct wl_client *client, void *data,
 	      uint32_t version, uint32_t id)
 {
-	struct wit_display *d = data;
+	struct wit_seat *seat = data;
+	struct wit_display *d = seat->display;
 	enum wl_seat_capability cap = 0;
 
 	if (!(d->config.resources & CONF_SEAT)) {
@@ -108,51 +210,213 @@ seat_bind(struct wl_client *client, void *data,
 	}
 
 	/* set capabilities according to configuration. Can be changed later */
-	if (d->config.resources & CONF_POINTER)
+	if (seat->caps & CONF_POINTER)
 		cap |= WL_SEAT_CAPABILITY_POINTER;
-	if (d->config.resources & CONF_KEYBOARD)
+	if (seat->caps & CONF_KEYBOARD)
 		cap |= WL_SEAT_CAPABILITY_KEYBOARD;
-	if (d->config.resources & CONF_TOUCH)
+	if (seat->caps & CONF_TOUCH)
 		cap |= WL_SEAT_CAPABILITY_TOUCH;
 
-	d->resources.seat =
+	seat->resources.seat =
 		wl_resource_create(client,
 				   &wl_seat_interface, version, id);
-	assertf(d->resources.seat, "Failed creating resource for seat");
-	wl_resource_set_implementation(d->resources.seat,
-				       &seat_default_implementation, data, NULL);
+	assertf(seat->resources.seat, "Failed creating resource for seat");
+	wl_resource_set_implementation(seat->resources.seat,
+				       &seat_default_implementation, seat, NULL);
+
+	if (seat->index == 0)
+		d->resources.seat = seat->resources.seat;
 
 	/* trigger handle_seat */
-	wl_seat_send_capabilities(d->resources.seat, cap);
+	wl_seat_send_capabilities(seat->resources.seat, cap);
 }
 
 /* -----------------------------------------------------------------------------
  *  Surface default implementation
  * ----------------------------------------------------------------------------- */
+/* free wit_surface and everything it holds (resource is not destroyed) */
+void
+surface_free(struct wit_surface *s)
+{
+	assert(s);
+
+	if (s->pending_buffer)
+		wl_list_remove(&s->pending_buffer_destroy.link);
+
+	wl_array_release(&s->frame_callbacks);
+	wl_array_release(&s->checksums);
+	free(s);
+}
+
+static struct wit_surface *
+surface_from_resource(struct wl_resource *resource)
+{
+	struct wit_surface *s = wl_resource_get_user_data(resource);
+
+	assertf(s, "No wit_surface for wl_surface@%u",
+		wl_resource_get_id(resource));
+
+	return s;
+}
+
 void
 surface_handle_destroy(struct wl_client *client, struct wl_resource *resource)
 {
 	assert(client && resource);
 
-	struct wit_surface *r, *next;
-	struct wit_display *d = wl_resource_get_user_data(resource);
-	uint32_t id = wl_resource_get_id(resource);
+	struct wit_surface *s = surface_from_resource(resource);
+
+	if (s->display->resources.surface == resource)
+		s->display->resources.surface = NULL;
+
+	wl_list_remove(&s->link);
+	wl_resource_destroy(s->resource);
+	surface_free(s);
+}
+
+static void
+surface_pending_buffer_destroyed(struct wl_listener *listener, void *data)
+{
+	struct wit_surface *s = wl_container_of(listener, s,
+						pending_buffer_destroy);
+
+	s->pending_buffer = NULL;
+}
+
+static void
+surface_handle_attach(struct wl_client *client, struct wl_resource *resource,
+		      struct wl_resource *buffer, int32_t x, int32_t y)
+{
+	assert(client && resource);
+
+	struct wit_surface *s = surface_from_resource(resource);
+
+	if (s->pending_buffer)
+		wl_list_remove(&s->pending_buffer_destroy.link);
+
+	s->pending_buffer = buffer;
 
-	wl_list_for_each_safe(r, next, &d->surfaces, link) {
-		if (r->id == id)
-			break;
+	if (buffer) {
+		s->pending_buffer_destroy.notify
+			= surface_pending_buffer_destroyed;
+		wl_resource_add_destroy_listener(buffer,
+						 &s->pending_buffer_destroy);
 	}
+}
 
-	wl_list_remove(&r->link);
-	wl_resource_destroy(r->resource);
-	free(r);
+static void
+surface_handle_damage(struct wl_client *client, struct wl_resource *resource,
+		      int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	/* we do not draw anything, so damage is not interesting */
+}
 
+static void
+surface_handle_frame(struct wl_client *client, struct wl_resource *resource,
+		     uint32_t callback)
+{
+	assert(client && resource);
+
+	struct wl_resource **cb;
+	struct wit_surface *s = surface_from_resource(resource);
+
+	cb = wl_array_add(&s->frame_callbacks, sizeof *cb);
+	assert(cb && "Out of memory");
+
+	*cb = wl_resource_create(client, &wl_callback_interface, 1, callback);
+	assertf(*cb, "Failed creating resource for frame callback");
+}
+
+static void
+surface_handle_set_region(struct wl_client *client,
+			  struct wl_resource *resource,
+			  struct wl_resource *region)
+{
+	/* regions are not supported yet (compositor can't create them) */
+}
+
+/* compute checksum of shm buffer in place
+ * and store the buffer if display has snapshot store */
+static void
+surface_checksum_buffer(struct wit_display *d, struct wit_surface *s,
+			struct wl_shm_buffer *buffer)
+{
+	uint32_t *checksum;
+	void *data;
+	int32_t width, height, stride;
+	uint32_t format;
+
+	checksum = wl_array_add(&s->checksums, sizeof *checksum);
+	assert(checksum && "Out of memory");
+
+	width = wl_shm_buffer_get_width(buffer);
+	height = wl_shm_buffer_get_height(buffer);
+	stride = wl_shm_buffer_get_stride(buffer);
+	format = wl_shm_buffer_get_format(buffer);
+
+	wl_shm_buffer_begin_access(buffer);
+	data = wl_shm_buffer_get_data(buffer);
+
+	*checksum = wit_shm_checksum(data, width, height, stride, format);
+
+	if (d->snapshot_dir)
+		wit_snapshot_store(d->snapshot_dir, *checksum, data,
+				   width, height, stride, format);
+
+	wl_shm_buffer_end_access(buffer);
+}
+
+static void
+surface_handle_commit(struct wl_client *client, struct wl_resource *resource)
+{
+	assert(client && resource);
+
+	struct wl_resource **cb;
+	struct wl_shm_buffer *shm_buffer;
+	struct wit_surface *s = surface_from_resource(resource);
+	struct wit_display *d = s->display;
+
+	if (s->pending_buffer) {
+		shm_buffer = wl_shm_buffer_get(s->pending_buffer);
+		if (shm_buffer)
+			surface_checksum_buffer(d, s, shm_buffer);
+
+		/* we don't keep contents, so client can reuse the buffer */
+		wl_buffer_send_release(s->pending_buffer);
+
+		wl_list_remove(&s->pending_buffer_destroy.link);
+		s->pending_buffer = NULL;
+	}
+
+	wl_array_for_each(cb, &s->frame_callbacks) {
+		wl_callback_send_done(*cb, 0);
+		wl_resource_destroy(*cb);
+	}
+
+	s->frame_callbacks.size = 0;
 }
 
 static const struct wl_surface_interface surface_default_implementation = {
 	surface_handle_destroy,
+	surface_handle_attach,
+	surface_handle_damage,
+	surface_handle_frame,
+	surface_handle_set_region, /* set_opaque_region */
+	surface_handle_set_region, /* set_input_region */
+	surface_handle_commit
 };
 
+/* wit_surface of resource or NULL when the resource is not our wl_surface */
+struct wit_surface *
+surface_from_object(struct wl_resource *resource)
+{
+	if (!wl_resource_instance_of(resource, &wl_surface_interface,
+				     &surface_default_implementation))
+		return NULL;
+
+	return wl_resource_get_user_data(resource);
+}
+
 /* -----------------------------------------------------------------------------
  *  Compositor default implementation
  * -------------------------------------------------------------------------- */
@@ -172,7 +436,7 @@ static void compositor_handle_create_surface(struct wl_client *client,
 		return;
 	}
 
-	s = malloc(sizeof *s);
+	s = calloc(1, sizeof *s);
 	assert(s && "Out of memory");
 
 	res = wl_resource_create(client, &wl_surface_interface,
@@ -180,10 +444,13 @@ static void compositor_handle_create_surface(struct wl_client *client,
 	assert(res);
 
 	wl_resource_set_implementation(res, &surface_default_implementation,
-					d, NULL);
+					s, NULL);
 
+	s->display = d;
 	s->resource = res;
 	s->id = id;
+	wl_array_init(&s->frame_callbacks);
+	wl_array_init(&s->checksums);
 
 	wl_list_insert(d->surfaces.next, &s->link);
 
@@ -220,3 +487,18 @@ compositor_bind(struct wl_client *client, void *data,
 	wl_resource_set_implementation(d->resources.compositor,
 				       &compositor_default_implementation, data, NULL);
 }
+
+/* -----------------------------------------------------------------------------
+ *  Synthetic globals
+ * ----------------------------------------------------------------------------- */
+void
+synthetic_bind(struct wl_client *client, void *data,
+	       uint32_t version, uint32_t id)
+{
+	struct wl_resource *res;
+
+	/* the object has no requests, it is destroyed with client */
+	res = wl_resource_create(client, &wit_synthetic_interface,
+				 version, id);
+	assertf(res, "Failed creating resource for synthetic global");
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * Scaling of object creation and destruction: client creates
+ * WIT_BENCH_OBJECTS (100000 by default) surfaces, frame callbacks and
+ * dummy objects, then destroys all of them, twice. Throughput of each
+ * tenth of objects is measured (so that O(n) behaviour is visible), as
+ * well as RSS growth of client and display and whether ids of destroyed
+ * objects are reused. Results are appended into
+ * benchmarks/objects-KIND.benchmark
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server.h>
+
+#include "test-runner.h"
+#include "wit.h"
+
+#define DEFAULT_OBJECTS 100000
+#define CHUNKS 10
+#define BATCH 512
+
+/* ---------------------------------
+ *  Dummy objects
+ * ------------------------------- */
+/* wl_factory creates wl_dummy objects, which can be only destroyed */
+static const struct wl_message dummy_requests[] = {
+	{ "destroy", "", NULL },
+};
+
+const struct wl_interface wl_dummy_interface = {
+	"wl_dummy", 1,
+	1, dummy_requests,
+	0, NULL,
+};
+
+static const struct wl_interface *factory_types[] = {
+	&wl_dummy_interface,
+};
+
+static const struct wl_message factory_requests[] = {
+	{ "create", "n", factory_types },
+};
+
+const struct wl_interface wl_factory_interface = {
+	"wl_factory", 1,
+	1, factory_requests,
+	0, NULL,
+};
+
+struct wl_dummy_interface {
+	void (*destroy) (struct wl_client *client, struct wl_resource *resource);
+};
+
+struct wl_factory_interface {
+	void (*create) (struct wl_client *client, struct wl_resource *resource,
+			uint32_t id);
+};
+
+static void
+dummy_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+static const struct wl_dummy_interface dummy_implementation = {
+	dummy_destroy,
+};
+
+static void
+factory_create(struct wl_client *client, struct wl_resource *resource,
+	       uint32_t id)
+{
+	struct wl_resource *res;
+
+	res = wl_resource_create(client, &wl_dummy_interface, 1, id);
+	assertf(res, "Failed creating dummy");
+	wl_resource_set_implementation(res, &dummy_implementation, NULL, NULL);
+}
+
+static const struct wl_factory_interface factory_implementation = {
+	factory_create,
+};
+
+static void
+factory_bind(struct wl_client *client, void *data, uint32_t version,
+	     uint32_t id)
+{
+	struct wl_resource *res;
+
+	res = wl_resource_create(client, &wl_factory_interface, version, id);
+	assertf(res, "Failed creating factory");
+	wl_resource_set_implementation(res, &factory_implementation,
+				       NULL, NULL);
+}
+
+/* ---------------------------------
+ *  Client
+ * ------------------------------- */
+enum kind {
+	KIND_SURFACE = 0,
+	KIND_CALLBACK,
+	KIND_DUMMY,
+	KINDS_NO
+};
+
+static const char *kind_names[] = {
+	"surface", "callback", "dummy"
+};
+
+struct bench {
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_proxy *factory;
+
+	/* surfaces for frame callbacks, BATCH callbacks on each */
+	struct wl_surface **surfaces;
+	uint32_t surfaces_count;
+
+	struct wl_proxy **objects;
+	uint32_t count;
+	uint32_t callbacks_done;
+};
+
+/* set before forking client */
+static uint32_t objects_count;
+
+static uint64_t
+now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* resident set size of process in kB */
+static long
+rss_kb(pid_t pid)
+{
+	char path[64];
+	long size, resident = -1;
+	FILE *f;
+
+	snprintf(path, sizeof path, "/proc/%d/statm", (int) pid);
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(f);
+
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void
+registry_handle_global(void *data, struct wl_registry *registry,
+		       uint32_t id, const char *interface, uint32_t version)
+{
+	struct bench *b = data;
+
+	if (strcmp(interface, "wl_compositor") == 0)
+		b->compositor = wl_registry_bind(registry, id,
+						 &wl_compositor_interface, 1);
+	else if (strcmp(interface, "wl_factory") == 0)
+		b->factory = wl_registry_bind(registry, id,
+					      &wl_factory_interface, 1);
+}
+
+static const struct wl_registry_listener registry_listener = {
+	registry_handle_global,
+	NULL
+};
+
+static void
+callback_done(void *data, struct wl_callback *callback, uint32_t serial)
+{
+	struct bench *b = data;
+
+	/* display destroyed it, so the id can be reused */
+	wl_callback_destroy(callback);
+	b->callbacks_done++;
+}
+
+static const struct wl_callback_listener callback_listener = {
+	callback_done
+};
+
+static void
+create_object(struct bench *b, enum kind kind, uint32_t i)
+{
+	struct wl_callback *cb;
+
+	switch (kind) {
+	case KIND_SURFACE:
+		b->objects[i] = (struct wl_proxy *)
+			wl_compositor_create_surface(b->compositor);
+		break;
+	case KIND_CALLBACK:
+		cb = wl_surface_frame(b->surfaces[i / BATCH]);
+		wl_callback_add_listener(cb, &callback_listener, b);
+		b->objects[i] = (struct wl_proxy *) cb;
+		break;
+	case KIND_DUMMY:
+		b->objects[i] = wl_proxy_marshal_constructor(b->factory, 0,
+							     &wl_dummy_interface,
+							     NULL);
+		break;
+	default:
+		assertf(0, "Unknown kind of object");
+	}
+
+	assert(b->objects[i]);
+}
+
+/* destroy all objects, returns how long it took */
+static uint64_t
+destroy_objects(struct bench *b, enum kind kind)
+{
+	uint64_t start = now_nsec();
+	uint32_t i;
+
+	switch (kind) {
+	case KIND_SURFACE:
+		for (i = 0; i < b->count; i++) {
+			wl_surface_destroy((struct wl_surface *) b->objects[i]);
+			if (i % BATCH == BATCH - 1)
+				wl_display_roundtrip(b->display);
+		}
+		break;
+	case KIND_CALLBACK:
+		/* commit makes display destroy callbacks of surface */
+		b->callbacks_done = 0;
+		for (i = 0; i < b->surfaces_count; i++) {
+			wl_surface_commit(b->surfaces[i]);
+			wl_display_roundtrip(b->display);
+		}
+		assert(b->callbacks_done == b->count);
+		break;
+	case KIND_DUMMY:
+		for (i = 0; i < b->count; i++) {
+			wl_proxy_marshal(b->objects[i], 0);
+			wl_proxy_destroy(b->objects[i]);
+			if (i % BATCH == BATCH - 1)
+				wl_display_roundtrip(b->display);
+		}
+		break;
+	default:
+		assertf(0, "Unknown kind of object");
+	}
+
+	wl_display_roundtrip(b->display);
+
+	return now_nsec() - start;
+}
+
+static void
+run_kind(struct bench *b, enum kind kind)
+{
+	uint64_t chunk_ns[CHUNKS], start, destroy_ns;
+	uint32_t i, chunk, round, max_id[2] = {0, 0}, id;
+	long client_rss, display_rss, client_grow = 0, display_grow = 0;
+	double first, last;
+	char name[64];
+
+	b->count = objects_count;
+
+	for (round = 0; round < 2; round++) {
+		client_rss = rss_kb(getpid());
+		display_rss = rss_kb(getppid());
+
+		for (chunk = 0; chunk < CHUNKS; chunk++) {
+			start = now_nsec();
+
+			for (i = chunk * b->count / CHUNKS;
+			     i < (chunk + 1) * b->count / CHUNKS; i++) {
+				create_object(b, kind, i);
+				if (i % BATCH == BATCH - 1)
+					wl_display_roundtrip(b->display);
+			}
+
+			wl_display_roundtrip(b->display);
+			chunk_ns[chunk] = now_nsec() - start;
+		}
+
+		for (i = 0; i < b->count; i++) {
+			id = wl_proxy_get_id(b->objects[i]);
+			if (id > max_id[round])
+				max_id[round] = id;
+		}
+
+		/* growth while all objects are alive */
+		client_grow = rss_kb(getpid()) - client_rss;
+		display_grow = rss_kb(getppid()) - display_rss;
+
+		destroy_ns = destroy_objects(b, kind);
+	}
+
+	/* objects per second of the first and the last tenth */
+	first = (double) (b->count / CHUNKS) * 1e9 / chunk_ns[0];
+	last = (double) (b->count / CHUNKS) * 1e9 / chunk_ns[CHUNKS - 1];
+
+	fprintf(stderr, "%s: %" PRIu32 " objects, create %.0f/s (first tenth)"
+		" %.0f/s (last tenth), destroy %.0f/s, rss growth client "
+		"%ld kB display %ld kB, max id %" PRIu32 " and %" PRIu32
+		" (ids %s reused)\n", kind_names[kind], b->count, first, last,
+		(double) b->count * 1e9 / destroy_ns, client_grow,
+		display_grow, max_id[0], max_id[1],
+		max_id[1] <= max_id[0] ? "are" : "are not");
+
+	snprintf(name, sizeof name, "objects-%s", kind_names[kind]);
+	assertf(write_benchmark(name, "%" PRIu32 " %.0f %.0f %.0f %ld %ld "
+				"%" PRIu32 " %" PRIu32, b->count, first, last,
+				(double) b->count * 1e9 / destroy_ns,
+				client_grow, display_grow, max_id[0],
+				max_id[1]) == 0,
+		"Failed writing benchmark %s", name);
+}
+
+static int
+objects_main(int sock)
+{
+	struct bench b;
+	struct wl_registry *registry;
+	uint32_t i;
+	int kind;
+
+	memset(&b, 0, sizeof b);
+
+	b.display = wl_display_connect(NULL);
+	assert(b.display);
+
+	registry = wl_display_get_registry(b.display);
+	wl_registry_add_listener(registry, &registry_listener, &b);
+	wl_display_roundtrip(b.display);
+
+	assertf(b.compositor, "No compositor");
+	assertf(b.factory, "No factory");
+
+	b.surfaces_count = objects_count / BATCH + 1;
+	b.surfaces = calloc(b.surfaces_count, sizeof *b.surfaces);
+	assert(b.surfaces);
+
+	for (i = 0; i < b.surfaces_count; i++) {
+		b.surfaces[i] = wl_compositor_create_surface(b.compositor);
+		assert(b.surfaces[i]);
+	}
+
+	b.objects = calloc(objects_count, sizeof *b.objects);
+	assert(b.objects);
+
+	for (kind = 0; kind < KINDS_NO; kind++)
+		run_kind(&b, kind);
+
+	assertf(wl_display_get_error(b.display) == 0,
+		"Error in display occured");
+
+	for (i = 0; i < b.surfaces_count; i++)
+		wl_surface_destroy(b.surfaces[i]);
+	wl_display_roundtrip(b.display);
+
+	free(b.surfaces);
+	free(b.objects);
+	wl_proxy_destroy(b.factory);
+	wl_compositor_destroy(b.compositor);
+	wl_registry_destroy(registry);
+	wl_display_disconnect(b.display);
+
+	return EXIT_SUCCESS;
+}
+
+BENCHMARK_TEST(objects_tst)
+{
+	struct wit_config conf = {CONF_COMPOSITOR, CONF_ALL, 0};
+	struct wit_display *d;
+	struct wl_global *factory;
+	const char *env;
+
+	env = getenv("WIT_BENCH_OBJECTS");
+	objects_count = env ? strtoul(env, NULL, 10) : DEFAULT_OBJECTS;
+	assertf(objects_count >= CHUNKS, "Wrong WIT_BENCH_OBJECTS");
+
+	d = wit_display_create(&conf);
+
+	factory = wl_global_create(d->display, &wl_factory_interface, 1,
+				   NULL, factory_bind);
+	assert(factory);
+
+	wit_display_create_client(d, objects_main);
+	wit_display_run(d);
+
+	/* client destroyed all surfaces */
+	assert(wl_list_empty(&d->surfaces));
+
+	wl_global_destroy(factory);
+	wit_display_destroy(d);
+}
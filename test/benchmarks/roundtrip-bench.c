@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * Latency of wl_display_roundtrip() and of wl_display.sync callback,
+ * measured idle and while display floods client with pointer motion
+ * events. Loads (events per second) can be set by WIT_BENCH_LOAD
+ * (comma separated list, 0 = idle) and time of measuring one load by
+ * WIT_BENCH_DURATION (ms). Percentiles are appended into
+ * benchmarks/roundtrip-LOAD.benchmark and benchmarks/sync-LOAD.benchmark
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-client.h>
+#include <wayland-server.h>
+
+#include "test-runner.h"
+#include "wit.h"
+#include "stats.h"
+
+#define DEFAULT_LOADS "0,1000,10000,100000"
+#define DEFAULT_DURATION 200 /* ms */
+#define MAX_SAMPLES 100000
+
+/* set before forking client */
+static uint32_t load_rate;
+static uint32_t duration;
+
+WIT_EVENT_DEFINE_GLOBAL(load_motion, &wl_pointer_interface, WL_POINTER_MOTION);
+
+static uint64_t
+now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+sync_done(void *data, struct wl_callback *callback, uint32_t serial)
+{
+	*((int *) data) = 1;
+}
+
+static const struct wl_callback_listener sync_listener = {
+	sync_done
+};
+
+/* time of wl_display.sync request until its callback is dispatched */
+static uint64_t
+measure_sync(struct wl_display *display)
+{
+	struct wl_callback *callback;
+	uint64_t start;
+	int done = 0;
+
+	start = now_nsec();
+
+	callback = wl_display_sync(display);
+	assert(callback);
+	wl_callback_add_listener(callback, &sync_listener, &done);
+
+	while (!done)
+		assert(wl_display_dispatch(display) != -1);
+
+	wl_callback_destroy(callback);
+
+	return now_nsec() - start;
+}
+
+static uint64_t
+measure_roundtrip(struct wl_display *display)
+{
+	uint64_t start = now_nsec();
+
+	assert(wl_display_roundtrip(display) != -1);
+
+	return now_nsec() - start;
+}
+
+static void
+report(const char *kind, uint64_t *samples, size_t n)
+{
+	struct wit_stats st;
+	char name[64];
+
+	wit_stats_compute(&st, samples, n);
+	snprintf(name, sizeof name, "%s-%" PRIu32, kind, load_rate);
+
+	fprintf(stderr, "%s at %" PRIu32 " ev/s: %zu samples, p50 %.1f us, "
+		"p90 %.1f us, p99 %.1f us, max %.1f us\n", kind, load_rate, n,
+		st.median / 1000.0, st.p90 / 1000.0, st.p99 / 1000.0,
+		st.max / 1000.0);
+
+	assertf(write_benchmark(name, "%zu %" PRIu64 " %" PRIu64 " %" PRIu64
+				" %" PRIu64, n, st.median, st.p90, st.p99,
+				st.max) == 0,
+		"Failed writing benchmark %s", name);
+}
+
+static int
+roundtrip_main(int sock)
+{
+	uint64_t *samples, half;
+	size_t n;
+	struct wit_client *c = wit_client_populate(sock);
+
+	samples = malloc(MAX_SAMPLES * sizeof *samples);
+	assert(samples);
+
+	/* make sure display has pointer */
+	wl_display_roundtrip(c->display);
+
+	/* display acknowledges and emits events in background */
+	if (load_rate)
+		assert(wit_client_ask_for_events(c, 0) > 0);
+
+	/* half of the time for each kind */
+	half = (uint64_t) duration * 500000;
+
+	n = 0;
+	half += now_nsec();
+	while (n < MAX_SAMPLES && now_nsec() < half)
+		samples[n++] = measure_roundtrip(c->display);
+	report("roundtrip", samples, n);
+
+	n = 0;
+	half += (uint64_t) duration * 500000;
+	while (n < MAX_SAMPLES && now_nsec() < half)
+		samples[n++] = measure_sync(c->display);
+	report("sync", samples, n);
+
+	free(samples);
+	wit_client_free(c);
+
+	return EXIT_SUCCESS;
+}
+
+static void
+run_load(uint32_t rate)
+{
+	struct wit_display *d;
+	struct wit_eventarray *ea;
+	uint32_t i, count;
+
+	load_rate = rate;
+	d = wit_display_create(NULL);
+
+	if (rate) {
+		/* enough events to cover whole measuring */
+		count = (uint64_t) rate * duration / 1000 + 1;
+
+		ea = wit_eventarray_create();
+		for (i = 0; i < count; i++)
+			wit_eventarray_add_timed(ea, DISPLAY,
+						 (uint64_t) i * 1000000 / rate,
+						 load_motion, i, 0, 0);
+		wit_display_add_events(d, ea);
+	}
+
+	wit_display_create_client(d, roundtrip_main);
+	wit_display_run(d);
+
+	if (rate)
+		wit_display_emit_events(d);
+
+	wit_display_destroy(d);
+}
+
+BENCHMARK_TEST(roundtrip_tst)
+{
+	const char *env;
+	char *loads, *tok, *saveptr = NULL;
+
+	env = getenv("WIT_BENCH_DURATION");
+	duration = env ? strtoul(env, NULL, 10) : DEFAULT_DURATION;
+	assertf(duration > 0, "Wrong WIT_BENCH_DURATION");
+
+	env = getenv("WIT_BENCH_LOAD");
+	loads = strdup(env ? env : DEFAULT_LOADS);
+	assert(loads);
+
+	for (tok = strtok_r(loads, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr))
+		run_load(strtoul(tok, NULL, 10));
+
+	free(loads);
+}
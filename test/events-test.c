@@ -20,7 +20,11 @@
  * OF THIS SOFTWARE.
  */
 
+#include <poll.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <wayland-server.h>
 #include <wayland-client.h>
@@ -28,6 +32,9 @@
 #include "test-runner.h"
 #include "wit.h"
 
+/* number of events in eventarray tests */
+#define EVENTS_NO 100
+
 TEST(define_event_tst)
 {
 	WIT_EVENT_DEFINE(pointer_motion, &wl_pointer_interface, WL_POINTER_MOTION);
@@ -89,18 +96,16 @@ TEST(define_global_event)
 
 TEST(eventarray_init_tst)
 {
-	int i;
-
 	/* tea = test event array, but you probably know what I was drinking
 	 * at the moment :) */
 	struct wit_eventarray *tea = wit_eventarray_create();
 	struct wit_eventarray *teabag = wit_eventarray_create();
 
-	for (i = 0; i < MAX_EVENTS; i++) {
-		assertf(tea->events[i] == 0, "Field no. %d is not inizialized", i);
-		assertf(teabag->events[i] == 0, "Field no. %d is not inizialized"
-			" (teabag)", i);
-	}
+	/* events are allocated with the first one */
+	assertf(tea->events == NULL && tea->size == 0,
+		"Events not initialized");
+	assertf(teabag->events == NULL && teabag->size == 0,
+		"Events not initialized (teabag)");
 
 	assertf(tea->count == 0, "Count not initialized");
 	assertf(tea->index == 0, "Index not initialized");
@@ -109,6 +114,24 @@ TEST(eventarray_init_tst)
 	wit_eventarray_free(teabag);
 }
 
+TEST(eventarray_grow_tst)
+{
+	struct wit_eventarray *ea = wit_eventarray_create();
+	WIT_EVENT_DEFINE(pointer_motion, &wl_pointer_interface, WL_POINTER_MOTION);
+	unsigned i, n = 10 * EVENTARRAY_INITIAL_SIZE + 1;
+
+	for (i = 0; i < n; i++)
+		assert(wit_eventarray_add(ea, DISPLAY, pointer_motion,
+					  i, i, i) == i + 1);
+
+	assert(ea->count == n);
+	assert(ea->size >= n);
+	for (i = 0; i < n; i++)
+		assert(ea->events[i]);
+
+	wit_eventarray_free(ea);
+}
+
 FAIL_TEST(eventarray_add_wrong_event_tst)
 {
 	struct wit_eventarray *tea = wit_eventarray_create();
@@ -249,6 +272,30 @@ TEST(eventarray_compare_tst)
 	wit_eventarray_free(e2);
 }
 
+BENCHMARK(eventarray_compare_bench)
+{
+	struct wit_eventarray *e1 = wit_eventarray_create();
+	struct wit_eventarray *e2 = wit_eventarray_create();
+	WIT_EVENT_DEFINE(pointer_motion, &wl_pointer_interface, WL_POINTER_MOTION);
+	uint64_t i;
+	int n;
+
+	for (n = 0; n < EVENTS_NO; ++n) {
+		wit_eventarray_add(e1, DISPLAY, pointer_motion, n, n, n);
+		wit_eventarray_add(e2, DISPLAY, pointer_motion, n, n, n);
+	}
+
+	benchmark_start(b);
+	for (i = 0; i < b->iterations; ++i)
+		assert(wit_eventarray_compare(e1, e2) == 0);
+	benchmark_stop(b);
+
+	benchmark_set_items(b, EVENTS_NO);
+
+	wit_eventarray_free(e1);
+	wit_eventarray_free(e2);
+}
+
 /* test adding arguments which are dynamically allocated:
  * string and array */
 TEST(ea_add_dynamic)
@@ -538,3 +585,423 @@ TEST(trigger_multiple_event_tst)
 
 	wit_display_destroy(d);
 }
+
+WIT_EVENT_DEFINE_GLOBAL(stress_motion, &wl_pointer_interface, WL_POINTER_MOTION);
+
+static int
+stress_main(int sock)
+{
+	struct pollfd pfd;
+	struct wit_client *c = wit_client_populate(sock);
+
+	assert(wit_client_ask_for_events(c, 0) > 0);
+
+	/* slow client: read once a while until display stops flooding us
+	 * or until we get disconnected */
+	pfd.fd = wl_display_get_fd(c->display);
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, 1000) == 1) {
+		if (wl_display_dispatch(c->display) == -1)
+			break;
+
+		usleep(10000);
+	}
+
+	if (wl_display_get_error(c->display)) {
+		/* wit_client_free would fail with broken connection */
+		wl_display_disconnect(c->display);
+		close(c->sock);
+		free(c);
+	} else {
+		wit_client_free(c);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+TEST(stress_tst)
+{
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL,
+				  CONF_OPT_STRESS};
+	struct wit_eventarray *ea = wit_eventarray_create();
+	struct wit_display *d;
+
+	conf.stress.start_rate = 1000;
+	conf.stress.max_rate = 512000;
+	conf.stress.step = 50;
+
+	d = wit_display_create(&conf);
+	wit_eventarray_add(ea, DISPLAY, stress_motion, 0, 0, 0);
+	wit_display_add_events(d, ea);
+
+	wit_display_create_client(d, stress_main);
+	wit_display_run(d);
+	wit_display_emit_events(d);
+
+	assert(d->stress.emitted > 0);
+	assertf(d->stress.saturated_rate || d->stress.broken_rate,
+		"Slow client was never saturated");
+	assertf(d->stress.max_sustained_rate < conf.stress.max_rate,
+		"Slow client sustained maximal rate");
+	assertf(d->stress.flush_eagain > 0, "No flush ended with EAGAIN");
+
+	wit_display_destroy(d);
+}
+
+/* pointers that got events (in client) */
+static struct wl_pointer *button_pointer, *motion_pointer;
+
+static void
+seat_pointer_enter(void *data, struct wl_pointer *pointer, uint32_t serial,
+		   struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+{
+}
+
+static void
+seat_pointer_leave(void *data, struct wl_pointer *pointer, uint32_t serial,
+		   struct wl_surface *surface)
+{
+}
+
+static void
+seat_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+		    wl_fixed_t x, wl_fixed_t y)
+{
+	motion_pointer = pointer;
+}
+
+static void
+seat_pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial,
+		    uint32_t time, uint32_t button, uint32_t state)
+{
+	button_pointer = pointer;
+}
+
+static void
+seat_pointer_axis(void *data, struct wl_pointer *pointer, uint32_t time,
+		  uint32_t axis, wl_fixed_t value)
+{
+}
+
+static const struct wl_pointer_listener seat_pointer_listener = {
+	seat_pointer_enter,
+	seat_pointer_leave,
+	seat_pointer_motion,
+	seat_pointer_button,
+	seat_pointer_axis
+};
+
+static int
+seats_main(int sock)
+{
+	struct wit_client_seat **seats;
+	struct wit_client *c = wit_client_populate(sock);
+
+	/* make sure all devices are created */
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+
+	assertf(c->seats.size == 2 * sizeof *seats,
+		"Got %zu extra seats", c->seats.size / sizeof *seats);
+	seats = c->seats.data;
+
+	assert(c->pointer.proxy && !c->keyboard.proxy && !c->touch.proxy);
+	assert(seats[0]->pointer && seats[0]->keyboard && !seats[0]->touch);
+	assert(seats[1]->pointer && !seats[1]->keyboard && seats[1]->touch);
+
+	wl_pointer_add_listener((struct wl_pointer *) c->pointer.proxy,
+				&seat_pointer_listener, c);
+	wl_pointer_add_listener((struct wl_pointer *) seats[0]->pointer,
+				&seat_pointer_listener, c);
+	wl_pointer_add_listener((struct wl_pointer *) seats[1]->pointer,
+				&seat_pointer_listener, c);
+
+	wit_client_barrier(c);
+
+	wit_client_ask_for_events(c, 0);
+	wl_display_roundtrip(c->display);
+
+	assert(button_pointer == (struct wl_pointer *) seats[1]->pointer);
+	assert(motion_pointer == (struct wl_pointer *) c->pointer.proxy);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(seats_tst)
+{
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL, 0};
+	struct wit_eventarray *ea = wit_eventarray_create();
+	struct wit_display *d;
+	uint32_t i;
+
+	conf.seats.count = 3;
+	conf.seats.caps[0] = CONF_POINTER;
+	conf.seats.caps[1] = CONF_POINTER | CONF_KEYBOARD;
+	conf.seats.caps[2] = CONF_POINTER | CONF_TOUCH;
+
+	d = wit_display_create(&conf);
+	assert(d->seats_count == 3);
+	assert(d->globals.wl_seat == d->seats[0].global);
+
+	wit_display_create_client(d, seats_main);
+	wit_display_run(d);
+	wit_display_barrier(d);
+
+	for (i = 0; i < d->seats_count; i++) {
+		assertf(d->seats[i].resources.seat, "No seat resource");
+		assertf(d->seats[i].resources.pointer, "No pointer resource");
+	}
+
+	/* seat 0 is mirrored */
+	assert(d->resources.seat == d->seats[0].resources.seat);
+	assert(d->resources.pointer == d->seats[0].resources.pointer);
+	assert(d->resources.keyboard == NULL);
+
+	assert(d->seats[1].resources.keyboard);
+	assert(d->seats[2].resources.touch);
+
+	wit_eventarray_set_seat(ea, 2);
+	wit_eventarray_add(ea, DISPLAY, pointer_e, 0, 0, 0x110, 1);
+	wit_eventarray_set_seat(ea, 0);
+	wit_eventarray_add(ea, DISPLAY, stress_motion, 0, 0, 0);
+
+	wit_display_add_events(d, ea);
+	wit_display_emit_events(d);
+
+	wit_display_destroy(d);
+}
+
+#define TIMED_EVENTS 5
+#define TIMED_STEP 20000 /* us */
+
+static int timed_count;
+static struct timespec timed_arrival[TIMED_EVENTS];
+
+static void
+timed_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+		     wl_fixed_t x, wl_fixed_t y)
+{
+	assert(timed_count < TIMED_EVENTS);
+	clock_gettime(CLOCK_MONOTONIC, &timed_arrival[timed_count++]);
+}
+
+static const struct wl_pointer_listener timed_pointer_listener = {
+	seat_pointer_enter,
+	seat_pointer_leave,
+	timed_pointer_motion,
+	seat_pointer_button,
+	seat_pointer_axis
+};
+
+static int
+timed_emit_main(int sock)
+{
+	long msec;
+	struct wit_client *c = wit_client_populate(sock);
+
+	wl_display_roundtrip(c->display);
+	wl_pointer_add_listener((struct wl_pointer *) c->pointer.proxy,
+				&timed_pointer_listener, c);
+
+	/* display acknowledges before the events are emitted */
+	assert(wit_client_ask_for_events(c, 0) == TIMED_EVENTS);
+	assert(timed_count == 0);
+
+	while (timed_count < TIMED_EVENTS)
+		assert(wl_display_dispatch(c->display) != -1);
+
+	msec = (timed_arrival[TIMED_EVENTS - 1].tv_sec
+		- timed_arrival[0].tv_sec) * 1000
+		+ (timed_arrival[TIMED_EVENTS - 1].tv_nsec
+		   - timed_arrival[0].tv_nsec) / 1000000;
+
+	/* last event is 80 ms after the first one, allow rounding */
+	assertf(msec >= (TIMED_EVENTS - 1) * TIMED_STEP / 1000 - 1,
+		"Events came too early (%ld ms)", msec);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(timed_emit_tst)
+{
+	int i;
+	struct wit_eventarray *ea = wit_eventarray_create();
+	struct wit_display *d = wit_display_create(NULL);
+
+	for (i = 0; i < TIMED_EVENTS; i++)
+		wit_eventarray_add_timed(ea, DISPLAY, i * TIMED_STEP,
+					 stress_motion, i, 0, 0);
+	assert(ea->timed);
+
+	wit_display_add_events(d, ea);
+	wit_display_create_client(d, timed_emit_main);
+	wit_display_run(d);
+	wit_display_emit_events(d);
+
+	assertf(ea->index == TIMED_EVENTS, "Emitted %u events", ea->index);
+	assert(d->schedule.left == 0);
+
+	wit_display_destroy(d);
+}
+
+TEST(timed_add_tst)
+{
+	struct wit_eventarray *ea = wit_eventarray_create();
+
+	wit_eventarray_add_timed(ea, DISPLAY, 1000, stress_motion, 0, 0, 0);
+	/* untimed event goes with the previous one */
+	wit_eventarray_add(ea, DISPLAY, stress_motion, 0, 0, 0);
+	wit_eventarray_add_timed(ea, DISPLAY, 5000, stress_motion, 0, 0, 0);
+
+	assert(wit_eventarray_next_time(ea) == 1000);
+	ea->index = 1;
+	assert(wit_eventarray_next_time(ea) == 1000);
+	ea->index = 2;
+	assert(wit_eventarray_next_time(ea) == 5000);
+
+	wit_eventarray_free(ea);
+}
+
+#define MERGED_EVENTS 8
+#define MERGED_STEP 1000 /* us */
+
+static int merged_count;
+
+static void
+merged_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+		      wl_fixed_t x, wl_fixed_t y)
+{
+	/* time carries position of event in the merged stream */
+	assertf(time == (uint32_t) merged_count,
+		"Got event %u, expected %d", time, merged_count);
+	merged_count++;
+}
+
+static const struct wl_pointer_listener merged_pointer_listener = {
+	seat_pointer_enter,
+	seat_pointer_leave,
+	merged_pointer_motion,
+	seat_pointer_button,
+	seat_pointer_axis
+};
+
+static int
+merged_main(int sock)
+{
+	struct wit_client *c = wit_client_populate(sock);
+
+	wl_display_roundtrip(c->display);
+	wl_pointer_add_listener((struct wl_pointer *) c->pointer.proxy,
+				&merged_pointer_listener, c);
+
+	assert(wit_client_ask_for_events(c, 0) == MERGED_EVENTS);
+
+	while (merged_count < MERGED_EVENTS)
+		assert(wl_display_dispatch(c->display) != -1);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(merged_tst)
+{
+	int i;
+	struct wit_eventarray *even = wit_eventarray_create();
+	struct wit_eventarray *odd = wit_eventarray_create();
+	struct wit_display *d = wit_display_create(NULL);
+
+	/* two streams which events need to be interleaved */
+	for (i = 0; i < MERGED_EVENTS; i += 2) {
+		wit_eventarray_add_timed(even, DISPLAY, i * MERGED_STEP,
+					 stress_motion, i, 0, 0);
+		wit_eventarray_add_timed(odd, DISPLAY, (i + 1) * MERGED_STEP,
+					 stress_motion, i + 1, 0, 0);
+	}
+
+	/* added in reversed order, time must win */
+	wit_display_add_events(d, odd);
+	wit_display_add_events(d, even);
+	assert(d->events == odd);
+
+	wit_display_create_client(d, merged_main);
+	wit_display_run(d);
+	wit_display_emit_events(d);
+
+	assert(even->index == even->count);
+	assert(odd->index == odd->count);
+	assert(d->schedule.left == 0);
+
+	wit_display_destroy(d);
+}
+
+#define PROBE_EVENTS 99
+
+static int probe_count;
+
+static void
+probe_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+		     wl_fixed_t x, wl_fixed_t y)
+{
+	wit_probe_dispatched(&wl_pointer_interface, WL_POINTER_MOTION);
+	probe_count++;
+}
+
+static const struct wl_pointer_listener probe_pointer_listener = {
+	seat_pointer_enter,
+	seat_pointer_leave,
+	probe_pointer_motion,
+	seat_pointer_button,
+	seat_pointer_axis
+};
+
+static int
+probe_main(int sock)
+{
+	struct wit_client *c = wit_client_populate(sock);
+
+	wl_display_roundtrip(c->display);
+	wl_pointer_add_listener((struct wl_pointer *) c->pointer.proxy,
+				&probe_pointer_listener, c);
+
+	assert(wit_client_ask_for_events(c, 0) == PROBE_EVENTS + 1);
+	wl_display_roundtrip(c->display);
+	assert(probe_count == PROBE_EVENTS);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(probe_tst)
+{
+	int i;
+	struct wit_stats st;
+	struct wit_config conf = {CONF_SEAT, CONF_ALL, CONF_OPT_PROBE};
+	struct wit_eventarray *ea = wit_eventarray_create();
+	struct wit_display *d = wit_display_create(&conf);
+
+	assert(d->probe);
+
+	for (i = 0; i < PROBE_EVENTS; i++)
+		wit_eventarray_add(ea, DISPLAY, stress_motion, i, 0, 0);
+	/* client doesn't stamp this one */
+	wit_eventarray_add(ea, DISPLAY, pointer_e, 0, 0, 0x110, 1);
+
+	wit_display_add_events(d, ea);
+	wit_display_create_client(d, probe_main);
+	wit_display_run(d);
+	wit_display_emit_events(d);
+
+	assert(d->probe->posted == PROBE_EVENTS + 1);
+	assert(wit_probe_stats(d->probe, &st, &wl_pointer_interface,
+			       WL_POINTER_MOTION) == PROBE_EVENTS);
+	assert(st.min > 0 && st.min <= st.median && st.median <= st.p99
+	       && st.p99 <= st.max);
+
+	/* button was not dispatched */
+	assert(wit_probe_stats(d->probe, &st, &wl_pointer_interface,
+			       WL_POINTER_BUTTON) == 0);
+
+	wit_display_destroy(d);
+}
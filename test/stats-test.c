@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <math.h>
+
+#include "test-runner.h"
+#include "stats.h"
+
+TEST(stats_tst)
+{
+	uint64_t samples[] = {5, 1, 4, 2, 3, 10, 9, 8, 7, 6};
+	struct wit_stats st;
+
+	wit_stats_compute(&st, samples, 10);
+
+	/* samples are sorted in place */
+	assert(samples[0] == 1 && samples[9] == 10);
+
+	assert(st.count == 10);
+	assert(st.min == 1 && st.max == 10);
+	assert(st.median == 5 && st.p90 == 9 && st.p99 == 10);
+	assert(fabs(st.mean - 5.5) < 1e-9);
+
+	assert(wit_percentile(samples, 0, 50) == 0);
+}
+
+TEST(welch_tst)
+{
+	struct wit_welch w;
+
+	/* too small samples */
+	assert(wit_welch_test(&w, 1, 0, 1, 2, 0, 1) == -1);
+
+	/* equal samples */
+	assert(wit_welch_test(&w, 10, 4, 10, 10, 4, 10) == 0);
+	assert(w.t == 0 && w.p > 0.999);
+
+	/* t = 5 / sqrt(0.4 + 0.4) with df = 18 gives p = 0.00002 */
+	assert(wit_welch_test(&w, 10, 4, 10, 15, 4, 10) == 0);
+	assert(fabs(w.t - 5.5902) < 1e-3 && fabs(w.df - 18) < 1e-9);
+	assert(w.p > 1e-5 && w.p < 5e-5);
+
+	/* t = 1 with df = 18 gives p = 0.33 */
+	assert(wit_welch_test(&w, 10, 4, 10, 9.1055728, 4, 10) == 0);
+	assert(w.t < 0 && fabs(w.p - 0.3306) < 1e-3);
+
+	/* no variance */
+	assert(wit_welch_test(&w, 10, 0, 5, 11, 0, 5) == 0);
+	assert(w.p == 0 && w.t > 0);
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "alloc-tracker.h"
+
+/* tracked live blocks (this many slots, some are always free,
+ * because deleted slots are reused only when probing comes by) */
+#define BLOCKS_SHIFT 20
+#define BLOCKS_NO (1 << BLOCKS_SHIFT)
+#define MAX_PROBES 128
+
+/* call sites, the site 0 collects sites that don't fit */
+#define SITES_SHIFT 12
+#define SITES_NO (1 << SITES_SHIFT)
+
+/* keys of block slots that don't hold any block */
+#define BLOCK_EMPTY ((uintptr_t) 0)
+#define BLOCK_DELETED ((uintptr_t) 1)
+
+struct block {
+	uintptr_t ptr;
+	uint64_t size;
+	uint32_t site;
+};
+
+struct site {
+	uintptr_t addr;		/* return address, 0 = free slot */
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes;		/* allocated in total */
+	int64_t live_bytes;
+	int64_t peak_bytes;
+};
+
+/* counters of site at the last mark */
+struct site_mark {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes;
+	int64_t live_bytes;
+};
+
+static struct block *blocks;
+static struct site *sites;
+static struct site_mark marks[SITES_NO];
+
+static int64_t live_blocks;
+static int64_t live_bytes;
+
+static inline size_t
+hash(uintptr_t key, int shift)
+{
+	/* Fibonacci hashing, low bits of pointers are mostly zeros */
+	return (size_t) (((uint64_t) (key >> 4) * 0x9e3779b97f4a7c15ULL)
+			 >> (64 - shift));
+}
+
+int
+alloc_tracker_init(void)
+{
+	void *b, *s;
+
+	if (blocks)
+		return 0;
+
+	/* pages are touched only when used */
+	b = mmap(NULL, BLOCKS_NO * sizeof *blocks, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (b == MAP_FAILED)
+		return -1;
+
+	s = mmap(NULL, SITES_NO * sizeof *sites, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (s == MAP_FAILED) {
+		munmap(b, BLOCKS_NO * sizeof *blocks);
+		return -1;
+	}
+
+	sites = s;
+	__atomic_store_n(&blocks, b, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static uint32_t
+get_site(uintptr_t addr)
+{
+	size_t i = hash(addr, SITES_SHIFT);
+	uintptr_t key;
+	int n;
+
+	for (n = 0; n < SITES_NO; ++n, i = (i + 1) & (SITES_NO - 1)) {
+		/* site 0 is reserved */
+		if (i == 0)
+			continue;
+
+		key = __atomic_load_n(&sites[i].addr, __ATOMIC_ACQUIRE);
+		if (key == addr)
+			return i;
+
+		if (key != 0)
+			continue;
+
+		/* claim the slot, or somebody else did it
+		 * meanwhile (maybe for the same site) */
+		if (__atomic_compare_exchange_n(&sites[i].addr, &key, addr, 0,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE)
+		    || key == addr)
+			return i;
+	}
+
+	return 0;
+}
+
+static void
+update_peak(int64_t *peak, int64_t live)
+{
+	int64_t p = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+	while (live > p
+	       && !__atomic_compare_exchange_n(peak, &p, live, 1,
+					       __ATOMIC_RELAXED,
+					       __ATOMIC_RELAXED))
+		;
+}
+
+void
+alloc_tracker_add(void *ptr, size_t size, void *site)
+{
+	struct block *table = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE);
+	uintptr_t key, p = (uintptr_t) ptr;
+	struct site *s;
+	size_t i;
+	int n;
+
+	if (table == NULL || ptr == NULL)
+		return;
+
+	i = hash(p, BLOCKS_SHIFT);
+	for (n = 0; n < MAX_PROBES; ++n, i = (i + 1) & (BLOCKS_NO - 1)) {
+		key = __atomic_load_n(&table[i].ptr, __ATOMIC_RELAXED);
+		if (key != BLOCK_EMPTY && key != BLOCK_DELETED)
+			continue;
+
+		/* the block can't be freed before we return it,
+		 * so size and site can be set after claiming the slot */
+		if (__atomic_compare_exchange_n(&table[i].ptr, &key, p, 0,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_RELAXED))
+			break;
+	}
+
+	/* table is too crowded, don't track this one */
+	if (n == MAX_PROBES)
+		return;
+
+	table[i].size = size;
+	table[i].site = get_site((uintptr_t) site);
+
+	s = &sites[table[i].site];
+	__atomic_fetch_add(&s->allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->bytes, size, __ATOMIC_RELAXED);
+	update_peak(&s->peak_bytes,
+		    __atomic_add_fetch(&s->live_bytes, size,
+				       __ATOMIC_RELAXED));
+
+	__atomic_fetch_add(&live_blocks, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&live_bytes, size, __ATOMIC_RELAXED);
+}
+
+size_t
+alloc_tracker_remove(void *ptr)
+{
+	struct block *table = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE);
+	uintptr_t key, p = (uintptr_t) ptr;
+	struct site *s;
+	size_t i, size;
+	int n;
+
+	if (table == NULL || ptr == NULL)
+		return 0;
+
+	i = hash(p, BLOCKS_SHIFT);
+	for (n = 0; n < MAX_PROBES; ++n, i = (i + 1) & (BLOCKS_NO - 1)) {
+		key = __atomic_load_n(&table[i].ptr, __ATOMIC_ACQUIRE);
+		if (key == p)
+			break;
+
+		/* deleted slots don't end the chain */
+		if (key == BLOCK_EMPTY)
+			return 0;
+	}
+
+	/* not tracked block */
+	if (n == MAX_PROBES)
+		return 0;
+
+	size = table[i].size;
+	s = &sites[table[i].site];
+	__atomic_fetch_add(&s->frees, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&s->live_bytes, table[i].size, __ATOMIC_RELAXED);
+
+	__atomic_fetch_sub(&live_blocks, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&live_bytes, table[i].size, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&table[i].ptr, BLOCK_DELETED, __ATOMIC_RELEASE);
+
+	return size;
+}
+
+int64_t
+alloc_tracker_live_blocks(void)
+{
+	return __atomic_load_n(&live_blocks, __ATOMIC_RELAXED);
+}
+
+int64_t
+alloc_tracker_live_bytes(void)
+{
+	return __atomic_load_n(&live_bytes, __ATOMIC_RELAXED);
+}
+
+void
+alloc_tracker_mark(void)
+{
+	int i;
+
+	if (sites == NULL)
+		return;
+
+	for (i = 0; i < SITES_NO; ++i) {
+		marks[i].allocs = sites[i].allocs;
+		marks[i].frees = sites[i].frees;
+		marks[i].bytes = sites[i].bytes;
+		marks[i].live_bytes = sites[i].live_bytes;
+		sites[i].peak_bytes = sites[i].live_bytes;
+	}
+}
+
+static void
+print_site(FILE *f, int i)
+{
+	Dl_info info;
+	const char *file;
+
+	if (i == 0) {
+		fprintf(f, "(other sites)\n");
+		return;
+	}
+
+	if (dladdr((void *) sites[i].addr, &info) == 0
+	    || info.dli_fname == NULL) {
+		fprintf(f, "%#" PRIxPTR "\n", sites[i].addr);
+		return;
+	}
+
+	file = strrchr(info.dli_fname, '/');
+	file = file ? file + 1 : info.dli_fname;
+
+	if (info.dli_sname)
+		fprintf(f, "%s(%s+%#tx)\n", file, info.dli_sname,
+			(char *) sites[i].addr - (char *) info.dli_saddr);
+	else
+		fprintf(f, "%s(+%#tx)\n", file,
+			(char *) sites[i].addr - (char *) info.dli_fbase);
+}
+
+void
+alloc_tracker_report(FILE *f, int top)
+{
+	static uint8_t printed[SITES_NO];
+	uint64_t allocs, bytes, best_allocs, best_bytes;
+	int i, best, n;
+
+	if (sites == NULL)
+		return;
+
+	memset(printed, 0, sizeof printed);
+
+	fprintf(f, "Top allocation sites (by bytes):\n"
+		"  %10s %10s %12s %12s  %s\n", "allocs", "frees",
+		"bytes", "peak bytes", "site");
+
+	/* selection of top sites, there are few of them. Sites with
+	 * the same bytes are ordered by number of allocations */
+	for (n = 0; n < top; ++n) {
+		best = -1;
+		best_allocs = best_bytes = 0;
+
+		for (i = 0; i < SITES_NO; ++i) {
+			allocs = sites[i].allocs - marks[i].allocs;
+			bytes = sites[i].bytes - marks[i].bytes;
+			if (printed[i] || allocs == 0)
+				continue;
+
+			if (best < 0 || bytes > best_bytes
+			    || (bytes == best_bytes && allocs > best_allocs)) {
+				best = i;
+				best_allocs = allocs;
+				best_bytes = bytes;
+			}
+		}
+
+		if (best < 0)
+			break;
+
+		printed[best] = 1;
+		fprintf(f, "  %10" PRIu64 " %10" PRIu64 " %12" PRIu64
+			" %12" PRId64 "  ", best_allocs,
+			sites[best].frees - marks[best].frees, best_bytes,
+			sites[best].peak_bytes);
+		print_site(f, best);
+	}
+}
+
+void
+alloc_tracker_report_leaks(FILE *f)
+{
+	int64_t blocks_no;
+	int i;
+
+	if (sites == NULL)
+		return;
+
+	fprintf(f, "Leaked blocks by site:\n");
+
+	for (i = 0; i < SITES_NO; ++i) {
+		blocks_no = (int64_t) (sites[i].allocs - sites[i].frees)
+			    - (int64_t) (marks[i].allocs - marks[i].frees);
+		if (blocks_no <= 0)
+			continue;
+
+		fprintf(f, "  %" PRId64 " blocks, %" PRId64 " bytes  ",
+			blocks_no, sites[i].live_bytes - marks[i].live_bytes);
+		print_site(f, i);
+	}
+}
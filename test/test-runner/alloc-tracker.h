@@ -0,0 +1,63 @@
+#ifndef __WIT_ALLOC_TRACKER_H__
+#define __WIT_ALLOC_TRACKER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Tracker of allocations made through interposed malloc & co.
+ *
+ * Every block is attributed to the call site (return address of the
+ * allocating call). Per site it counts allocations, frees, allocated bytes
+ * and live and peak bytes, so that it shows both leaks and allocation hot
+ * spots. Both tables (blocks and sites) are lock-free hash tables in memory
+ * mapped by alloc_tracker_init(), so the tracker itself never allocates.
+ * Blocks that don't fit into the table (or were allocated before
+ * alloc_tracker_init()) are not tracked.
+ */
+
+/* map the tables, until then nothing is tracked.
+ * Returns 0 on success, -1 on error */
+int
+alloc_tracker_init(void);
+
+/* register new block of size bytes allocated from call site */
+void
+alloc_tracker_add(void *ptr, size_t size, void *site);
+
+/* unregister block before it's freed (so that it can't be allocated
+ * again before it's unregistered), returns its size */
+size_t
+alloc_tracker_remove(void *ptr);
+
+/* number of live (tracked) blocks */
+int64_t
+alloc_tracker_live_blocks(void);
+
+/* number of live (tracked) bytes */
+int64_t
+alloc_tracker_live_bytes(void);
+
+/* start new period (test): reports are relative to the last mark
+ * and peaks are reset to the current live bytes */
+void
+alloc_tracker_mark(void);
+
+/**
+ * Print sites that allocated the most bytes since the last mark
+ *
+ * Sites that allocated the same number of bytes are ordered by number
+ * of allocations.
+ *
+ * @param f    where to print
+ * @param top  how many sites to print
+ */
+void
+alloc_tracker_report(FILE *f, int top);
+
+/* print sites that have more live blocks than at the last mark */
+void
+alloc_tracker_report_leaks(FILE *f);
+
+#endif /* __WIT_ALLOC_TRACKER_H__ */
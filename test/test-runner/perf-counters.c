@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf-counters.h"
+#include "wit-assert.h"
+
+const char *perf_counter_names[PERF_COUNTERS_NO] = {
+	[PERF_INSTRUCTIONS] = "instructions",
+	[PERF_CYCLES] = "cycles",
+	[PERF_CACHE_MISSES] = "cache_misses",
+	[PERF_BRANCH_MISSES] = "branch_misses"
+};
+
+static const uint64_t perf_counter_configs[PERF_COUNTERS_NO] = {
+	[PERF_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+	[PERF_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+	[PERF_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+	[PERF_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/* format of read() given by read_format in perf_counters_open() */
+struct perf_read_value {
+	uint64_t value;
+	uint64_t time_enabled;
+	uint64_t time_running;
+};
+
+static int
+perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+		int group_fd, unsigned long flags)
+{
+	return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+int
+perf_counters_open(struct perf_counters *pc)
+{
+	struct perf_event_attr attr;
+	int i, opened = 0;
+
+	assert(pc);
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i) {
+		memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = perf_counter_configs[i];
+		attr.disabled = 1;
+		/* count in client too */
+		attr.inherit = 1;
+		/* user space only, it is allowed with
+		 * perf_event_paranoid <= 2 */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+				   | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		pc->fds[i] = perf_event_open(&attr, 0, -1, -1,
+					     PERF_FLAG_FD_CLOEXEC);
+		if (pc->fds[i] < 0)
+			dbg("Opening counter '%s' failed: %s\n",
+			    perf_counter_names[i], strerror(errno));
+		else
+			++opened;
+	}
+
+	return opened;
+}
+
+void
+perf_counters_close(struct perf_counters *pc)
+{
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i) {
+		if (pc->fds[i] >= 0)
+			close(pc->fds[i]);
+
+		pc->fds[i] = -1;
+	}
+}
+
+static void
+perf_counters_ioctl(struct perf_counters *pc, unsigned long request)
+{
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i)
+		if (pc->fds[i] >= 0)
+			ioctl(pc->fds[i], request, 0);
+}
+
+void
+perf_counters_enable(struct perf_counters *pc)
+{
+	perf_counters_ioctl(pc, PERF_EVENT_IOC_ENABLE);
+}
+
+void
+perf_counters_disable(struct perf_counters *pc)
+{
+	perf_counters_ioctl(pc, PERF_EVENT_IOC_DISABLE);
+}
+
+void
+perf_counters_reset(struct perf_counters *pc)
+{
+	perf_counters_ioctl(pc, PERF_EVENT_IOC_RESET);
+}
+
+void
+perf_counters_read(struct perf_counters *pc, uint64_t *values)
+{
+	struct perf_read_value rv;
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i) {
+		values[i] = PERF_COUNT_UNAVAILABLE;
+
+		if (pc->fds[i] < 0
+		    || read(pc->fds[i], &rv, sizeof rv) != sizeof rv)
+			continue;
+
+		/* counter was multiplexed with others */
+		if (rv.time_running > 0 && rv.time_running < rv.time_enabled)
+			rv.value = (double) rv.value * rv.time_enabled
+				   / rv.time_running;
+
+		values[i] = rv.value;
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef __WIT_PERF_COUNTERS_H__
+#define __WIT_PERF_COUNTERS_H__
+
+#include <stdint.h>
+
+/**
+ * Hardware performance counters of test (perf_event_open(2))
+ *
+ * Counters count in user space of the process that opened them and of all
+ * processes it forks afterwards (the client). Counts of children are added
+ * when they exit. Counters that can not be opened (no PMU, restrictive
+ * perf_event_paranoid, ...) are marked by PERF_COUNT_UNAVAILABLE.
+ */
+
+enum perf_counter {
+	PERF_INSTRUCTIONS,
+	PERF_CYCLES,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_COUNTERS_NO
+};
+
+#define PERF_COUNT_UNAVAILABLE UINT64_MAX
+
+/* names of counters as used in benchmarks */
+extern const char *perf_counter_names[PERF_COUNTERS_NO];
+
+struct perf_counters {
+	int fds[PERF_COUNTERS_NO];
+};
+
+/**
+ * Open counters (disabled)
+ *
+ * @return  number of counters that were opened
+ */
+int
+perf_counters_open(struct perf_counters *pc);
+
+void
+perf_counters_close(struct perf_counters *pc);
+
+void
+perf_counters_enable(struct perf_counters *pc);
+
+void
+perf_counters_disable(struct perf_counters *pc);
+
+/* set counts of counters to 0 */
+void
+perf_counters_reset(struct perf_counters *pc);
+
+/**
+ * Read counters
+ *
+ * When the kernel multiplexed counters, counts are scaled to the whole
+ * time they were enabled.
+ *
+ * @param values  array of PERF_COUNTERS_NO counts
+ */
+void
+perf_counters_read(struct perf_counters *pc, uint64_t *values);
+
+#endif /* __WIT_PERF_COUNTERS_H__ */
@@ -21,11 +21,19 @@
  * OF THIS SOFTWARE.
  */
 
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <errno.h>
 #include <dirent.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "test-runner.h"
@@ -90,23 +98,284 @@ print_open_fds(void)
 	closedir(dir);
 }
 
-/* get current HEAD commit hash */
+#define HASH_LEN 40
+
+/* read commit of ref (e. g. refs/heads/master) from git directory,
+ * the ref is either in its own file or in packed-refs */
+static int
+read_git_ref(const char *gitdir, const char *ref, char *hash)
+{
+	char path[PATH_MAX], line[PATH_MAX], name[PATH_MAX];
+	int found = 0;
+	FILE *f;
+
+	snprintf(path, sizeof path, "%s/%s", gitdir, ref);
+	f = fopen(path, "r");
+	if (f) {
+		found = fscanf(f, "%40s", hash) == 1;
+		fclose(f);
+		return found ? 0 : -1;
+	}
+
+	snprintf(path, sizeof path, "%s/packed-refs", gitdir);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -1;
+
+	while (!found && fgets(line, sizeof line, f))
+		found = sscanf(line, "%40s %s", hash, name) == 2
+			&& strcmp(name, ref) == 0;
+
+	fclose(f);
+	return found ? 0 : -1;
+}
+
+/* read HEAD from .git in current directory or in its parents */
+static int
+read_git_head(char *hash)
+{
+	char dir[PATH_MAX], gitdir[PATH_MAX], line[PATH_MAX];
+	char common[PATH_MAX], ref[PATH_MAX];
+	struct stat st;
+	char *slash;
+	FILE *f;
+
+	if (getcwd(dir, sizeof dir) == NULL)
+		return -1;
+
+	for (;;) {
+		snprintf(gitdir, sizeof gitdir, "%s/.git", dir);
+		if (stat(gitdir, &st) == 0)
+			break;
+
+		slash = strrchr(dir, '/');
+		if (slash == NULL || dir[1] == '\0')
+			return -1;
+
+		/* keep the root */
+		slash[slash == dir ? 1 : 0] = '\0';
+	}
+
+	/* worktrees and submodules have file with path to git directory */
+	if (S_ISREG(st.st_mode)) {
+		f = fopen(gitdir, "r");
+		if (f == NULL)
+			return -1;
+
+		if (fscanf(f, "gitdir: %s", line) != 1) {
+			fclose(f);
+			return -1;
+		}
+		fclose(f);
+
+		if (line[0] == '/')
+			snprintf(gitdir, sizeof gitdir, "%s", line);
+		else
+			snprintf(gitdir, sizeof gitdir, "%s/%s", dir, line);
+	}
+
+	snprintf(line, sizeof line, "%s/HEAD", gitdir);
+	f = fopen(line, "r");
+	if (f == NULL)
+		return -1;
+
+	if (fgets(line, sizeof line, f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	/* detached HEAD */
+	if (sscanf(line, "ref: %s", ref) != 1)
+		return sscanf(line, "%40s", hash) == 1 ? 0 : -1;
+
+	if (read_git_ref(gitdir, ref, hash) == 0)
+		return 0;
+
+	/* refs of worktree are in the common git directory */
+	snprintf(line, sizeof line, "%s/commondir", gitdir);
+	f = fopen(line, "r");
+	if (f == NULL)
+		return -1;
+
+	if (fscanf(f, "%s", line) != 1) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	if (line[0] == '/')
+		snprintf(common, sizeof common, "%s", line);
+	else
+		snprintf(common, sizeof common, "%s/%s", gitdir, line);
+
+	return read_git_ref(common, ref, hash);
+}
+
+/* get current HEAD commit hash
+ *
+ * The hash is looked up only once per process (the test-runner does it in
+ * main(), so tests forked from it have it already) and is passed to
+ * programs started by tests or by make bench in WIT_HEAD_COMMIT */
 const char *
 get_head_commit(void)
 {
-	/* hash is 41-characters long */
-	static char hash[42];
+	static char hash[HASH_LEN + 1];
+	static int resolved;
+	const char *env;
+	FILE *s;
+	int ok = 0;
+
+	if (resolved)
+		return hash[0] ? hash : NULL;
+
+	resolved = 1;
+
+	env = getenv("WIT_HEAD_COMMIT");
+	if (env && *env) {
+		snprintf(hash, sizeof hash, "%s", env);
+		return hash;
+	}
 
 	/* use popen. It's better than reading it directly from .git/heads/
 	 * because it works everywhere in the project folders hierarchy */
-	FILE *s = popen("git rev-parse HEAD", "r");
-	if (!s)
-		return NULL;
+	s = popen("git rev-parse HEAD 2>/dev/null", "r");
+	if (s) {
+		ok = fscanf(s, "%40s", hash) == 1;
+		if (pclose(s) != 0)
+			ok = 0;
+	}
 
-	fscanf(s, "%41s", hash);
-	hash[41] = '\0';
+	/* no git, read what we can understand */
+	if (!ok)
+		ok = read_git_head(hash) == 0;
 
-	pclose(s);
+	if (!ok) {
+		hash[0] = '\0';
+		return NULL;
+	}
+
+	setenv("WIT_HEAD_COMMIT", hash, 1);
 
 	return hash;
 }
+
+static int
+append_record(const char *path, const char *prefix, const char *record)
+{
+	FILE *f;
+	int stat;
+
+	f = fopen(path, "a");
+	if (f == NULL)
+		return -1;
+
+	stat = fprintf(f, "%s%s\n", prefix, record);
+
+	if (fclose(f) != 0)
+		stat = -1;
+
+	return stat < 0 ? -1 : 0;
+}
+
+/* append record into benchmarks/NAME.SUFFIX and into results of
+ * make bench run when there are some */
+static int
+save_record(const char *name, const char *suffix, const char *prefix,
+	    const char *record)
+{
+	char path[255];
+	const char *results;
+	int stat;
+
+	snprintf(path, sizeof path, "benchmarks/%s.%s", name, suffix);
+	stat = append_record(path, prefix, record);
+
+	/* make bench collects results of one run into one file too */
+	results = getenv("WIT_BENCH_RESULTS");
+	if (stat == 0 && results) {
+		snprintf(path, sizeof path, "%s ", name);
+		stat = append_record(results, path, record);
+	}
+
+	return stat;
+}
+
+int
+write_benchmark(const char *name, const char *fmt, ...)
+{
+	char prefix[255];
+	char *record;
+	const char *head;
+	va_list args;
+	int stat;
+
+	head = get_head_commit();
+
+	va_start(args, fmt);
+	stat = vasprintf(&record, fmt, args);
+	va_end(args);
+
+	if (stat < 0)
+		return -1;
+
+	snprintf(prefix, sizeof prefix, "%lu %s ",
+		 time(NULL), head ? head : "xxx");
+	stat = save_record(name, "benchmark", prefix, record);
+
+	free(record);
+
+	return stat;
+}
+
+int
+write_benchmark_json(const char *name, const char *fmt, ...)
+{
+	char *fields, *record;
+	const char *head;
+	va_list args;
+	int stat;
+
+	head = get_head_commit();
+
+	va_start(args, fmt);
+	stat = vasprintf(&fields, fmt, args);
+	va_end(args);
+
+	if (stat < 0)
+		return -1;
+
+	stat = asprintf(&record, "{\"timestamp\": %lu, \"commit\": \"%s\", "
+			"\"name\": \"%s\", %s}", time(NULL),
+			head ? head : "xxx", name, fields);
+	free(fields);
+
+	if (stat < 0)
+		return -1;
+
+	stat = save_record(name, "jsonl", "", record);
+	free(record);
+
+	return stat;
+}
+
+/* create unlinked file of given size (usable as shm pool) */
+int
+create_anonymous_file(off_t size)
+{
+	char template[] = "/tmp/wit-shm-XXXXXX";
+	int fd;
+
+	fd = mkstemp(template);
+	if (fd < 0)
+		return -1;
+
+	unlink(template);
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
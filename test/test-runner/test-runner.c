@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <string.h>
 #include <assert.h>
 #include <err.h>
@@ -35,6 +36,10 @@
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <sched.h>
+#include <inttypes.h>
 
 #include "config.h"
 
@@ -47,8 +52,10 @@
 
 #include "test-runner.h"
 #include "wit-assert.h"
+#include "stats.h"
+#include "perf-counters.h"
+#include "alloc-tracker.h"
 
-static int num_alloc;
 static void* (*sys_malloc)(size_t);
 static void (*sys_free)(void*);
 static void* (*sys_realloc)(void*, size_t);
@@ -56,40 +63,60 @@ static void* (*sys_calloc)(size_t, size_t);
 
 int leak_check_enabled;
 
+/* print this many top allocation sites after test (WIT_ALLOC_REPORT) */
+static int alloc_report;
+
 extern const struct test __start_test_section, __stop_test_section;
 
+/* allocations are attributed to the caller of malloc & co. */
 __attribute__ ((visibility("default"))) void *
 malloc(size_t size)
 {
-	num_alloc++;
-	return sys_malloc(size);
+	void *mem = sys_malloc(size);
+
+	alloc_tracker_add(mem, size, __builtin_return_address(0));
+	return mem;
 }
 
 __attribute__ ((visibility("default"))) void
 free(void* mem)
 {
-	if (mem != NULL)
-		num_alloc--;
+	alloc_tracker_remove(mem);
 	sys_free(mem);
 }
 
 __attribute__ ((visibility("default"))) void *
 realloc(void* mem, size_t size)
 {
-	if (mem == NULL)
-		num_alloc++;
-	return sys_realloc(mem, size);
+	size_t old_size;
+	void *new_mem;
+
+	/* realloc(NULL, size) allocates and realloc(mem, 0) frees */
+	old_size = alloc_tracker_remove(mem);
+	new_mem = sys_realloc(mem, size);
+
+	if (new_mem)
+		alloc_tracker_add(new_mem, size, __builtin_return_address(0));
+	else if (mem && size > 0)
+		/* failed, the old block is still there */
+		alloc_tracker_add(mem, old_size, __builtin_return_address(0));
+
+	return new_mem;
 }
 
 __attribute__ ((visibility("default"))) void *
 calloc(size_t nmemb, size_t size)
 {
+	void *mem;
+
+	/* dlsym() calls calloc before we have it and can do without it */
 	if (sys_calloc == NULL)
 		return NULL;
 
-	num_alloc++;
+	mem = sys_calloc(nmemb, size);
+	alloc_tracker_add(mem, nmemb * size, __builtin_return_address(0));
 
-	return sys_calloc(nmemb, size);
+	return mem;
 }
 
 static const struct test *
@@ -109,9 +136,29 @@ usage(const char *name, int status)
 {
 	const struct test *t;
 
-	fprintf(stderr, "Usage: %s [TEST]\n\n"
+	fprintf(stderr, "Usage: %s [-j N] [--shard I/N] [--bench N "
+		"[--warmup N]] [--cpu LIST] [--perf] [TEST]\n\n"
 		"With no arguments, run all test.  Specify test case to run\n"
-		"only that test without forking.  Available tests:\n\n",
+		"only that test without forking.\n\n"
+		"  -j N           run N tests at once (0 = number of CPUs),\n"
+		"                 the slowest tests (according to benchmarks)\n"
+		"                 are started first. Output of tests is\n"
+		"                 buffered and printed in order of tests\n"
+		"  --shard I/N    split tests into N shards with similar\n"
+		"                 duration and run only the I-th one (from 0)\n"
+		"  --bench N      run each test N times (each time in new\n"
+		"                 process) and save statistics of durations\n"
+		"                 (WIT_BENCH_ITERATIONS), BENCHMARKs repeat\n"
+		"                 their measurement N times\n"
+		"  --warmup N     number of unmeasured runs before measuring\n"
+		"                 (default 2, WIT_BENCH_WARMUP)\n"
+		"  --cpu LIST     pin tests (display and client) to CPUs,\n"
+		"                 e.g. 0 or 2,3 or 0-3 (WIT_BENCH_CPU)\n"
+		"  --perf         count instructions, cycles, cache and branch\n"
+		"                 misses of tests (WIT_PERF)\n\n"
+		"WIT_ALLOC_REPORT=N prints N call sites with the most\n"
+		"allocated bytes after each test.\n\n"
+		"Available tests:\n\n",
 		name);
 
 	for (t = &__start_test_section; t < &__stop_test_section; t++)
@@ -122,27 +169,234 @@ usage(const char *name, int status)
 	exit(status);
 }
 
+#define NSEC_PER_SEC ((uint64_t) 1000000000)
+
+/* benchmark mode (see --bench), 0 iterations = off */
+static int bench_iterations;
+static int bench_warmup = 2;
+
+/* minimal duration of measured region of BENCHMARK (ms) */
+static int bench_duration = 200;
+
+#define BENCH_MAX_ITERATIONS 1000000000ULL
+
+/* count hardware events of tests (see --perf) */
+static int perf_enabled;
+
+/* counters of running BENCHMARK, controlled by benchmark_start/stop */
+static struct perf_counters *bench_perf;
+
+static uint64_t
+timespec_diff_nsec(const struct timespec *start, const struct timespec *end)
+{
+	/* nanoseconds can be smaller in end, so don't subtract
+	 * the parts separately */
+	return (int64_t) (end->tv_sec - start->tv_sec) * NSEC_PER_SEC
+		+ (end->tv_nsec - start->tv_nsec);
+}
+
+/* configuration of run as JSON object (built in main) */
+static char *bench_config;
+
+struct proc_usage {
+	uint64_t user;		/* CPU time in user space (ns) */
+	uint64_t sys;		/* CPU time in kernel (ns) */
+	long max_rss;		/* kB */
+	long nvcsw;		/* voluntary context switches */
+	long nivcsw;		/* involuntary context switches */
+};
+
+/* resources used by test */
+struct test_usage {
+	uint64_t wall;			/* ns */
+	struct proc_usage display;	/* the test process */
+	struct proc_usage client;	/* its (terminated) children */
+
+	/* hardware events of display and client together,
+	 * PERF_COUNT_UNAVAILABLE when not counted */
+	uint64_t perf[PERF_COUNTERS_NO];
+};
+
 static void
-run_test(const struct test *t)
+get_proc_usage(struct proc_usage *pu, int who)
 {
-	int cur_alloc = num_alloc;
-	int cur_fds, num_fds;
-	struct timespec start, end;
-	char bench_name[255];
-	const char *head;
-	FILE *f;
+	struct rusage ru;
+
+	if (getrusage(who, &ru) < 0)
+		err(EXIT_FAILURE, "getrusage failed");
+
+	pu->user = ru.ru_utime.tv_sec * NSEC_PER_SEC
+		   + ru.ru_utime.tv_usec * 1000;
+	pu->sys = ru.ru_stime.tv_sec * NSEC_PER_SEC
+		  + ru.ru_stime.tv_usec * 1000;
+	pu->max_rss = ru.ru_maxrss;
+	pu->nvcsw = ru.ru_nvcsw;
+	pu->nivcsw = ru.ru_nivcsw;
+}
 
-	cur_fds = count_open_fds();
+/* get usage of this process and its children. Clients are waited for
+ * when display is destroyed, so call this after the test */
+static void
+get_test_usage(struct test_usage *u, uint64_t wall)
+{
+	u->wall = wall;
+	get_proc_usage(&u->display, RUSAGE_SELF);
+	get_proc_usage(&u->client, RUSAGE_CHILDREN);
+}
 
-	clock_gettime(CLOCK_MONOTONIC, &start);
-	t->run();
-	clock_gettime(CLOCK_MONOTONIC, &end);
+static void
+add_proc_usage(struct proc_usage *sum, const struct proc_usage *pu)
+{
+	sum->user += pu->user;
+	sum->sys += pu->sys;
+	if (pu->max_rss > sum->max_rss)
+		sum->max_rss = pu->max_rss;
+	sum->nvcsw += pu->nvcsw;
+	sum->nivcsw += pu->nivcsw;
+}
+
+/* divide all but maximum by n */
+static void
+div_proc_usage(struct proc_usage *pu, int n)
+{
+	pu->user /= n;
+	pu->sys /= n;
+	pu->nvcsw /= n;
+	pu->nivcsw /= n;
+}
+
+static void
+perf_unavailable(uint64_t *perf)
+{
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i)
+		perf[i] = PERF_COUNT_UNAVAILABLE;
+}
+
+/* add counts, unavailable counter stays unavailable */
+static void
+add_perf(uint64_t *sum, const uint64_t *perf)
+{
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i) {
+		if (perf[i] == PERF_COUNT_UNAVAILABLE)
+			sum[i] = PERF_COUNT_UNAVAILABLE;
+		else if (sum[i] != PERF_COUNT_UNAVAILABLE)
+			sum[i] += perf[i];
+	}
+}
+
+static int
+perf_available(const uint64_t *perf)
+{
+	int i;
+
+	for (i = 0; i < PERF_COUNTERS_NO; ++i)
+		if (perf[i] != PERF_COUNT_UNAVAILABLE)
+			return 1;
+
+	return 0;
+}
+
+/* write counts as JSON object (or null when nothing was counted) or as
+ * space separated list when json is 0 */
+static const char *
+perf_str(char *buf, size_t size, const uint64_t *perf, int json)
+{
+	int i, len = 0;
+
+	if (json && !perf_available(perf)) {
+		snprintf(buf, size, "null");
+		return buf;
+	}
+
+	buf[0] = '\0';
+	for (i = 0; i < PERF_COUNTERS_NO && len < (int) size; ++i) {
+		if (json)
+			len += snprintf(buf + len, size - len, "%s\"%s\": ",
+					i ? ", " : "{", perf_counter_names[i]);
+		if (len >= (int) size)
+			break;
+
+		if (perf[i] == PERF_COUNT_UNAVAILABLE)
+			len += snprintf(buf + len, size - len, "%s",
+					json ? "null" : i ? " -" : "-");
+		else
+			len += snprintf(buf + len, size - len, "%s%" PRIu64,
+					json || !i ? "" : " ", perf[i]);
+	}
+
+	if (json && len < (int) size)
+		snprintf(buf + len, size - len, "}");
+
+	return buf;
+}
+
+static const char *
+proc_usage_json(char *buf, size_t size, const struct proc_usage *pu)
+{
+	snprintf(buf, size, "{\"user_ns\": %" PRIu64 ", \"sys_ns\": %" PRIu64
+		 ", \"max_rss_kb\": %ld, \"voluntary_csw\": %ld, "
+		 "\"involuntary_csw\": %ld}", pu->user, pu->sys, pu->max_rss,
+		 pu->nvcsw, pu->nivcsw);
+
+	return buf;
+}
+
+/* append "timestamp commit seconds nanoseconds" to test's benchmark
+ * and structured record with resource usage to test's .jsonl file.
+ * When test was run more times, usage is mean of the runs */
+static void
+save_benchmark(const struct test *t, const struct test_usage *u, int runs)
+{
+	char display[255], client[255], perf[255];
+	char name[255];
+
+	if (write_benchmark(t->name, "%" PRIu64 " %" PRIu64,
+			    u->wall / NSEC_PER_SEC, u->wall % NSEC_PER_SEC) < 0)
+		errx(EXIT_FAILURE, "Writing benchmark %s failed", t->name);
+
+	if (write_benchmark_json(t->name, "\"wall_ns\": %" PRIu64 ", "
+				 "\"runs\": %d, \"display\": %s, "
+				 "\"client\": %s, \"perf\": %s, "
+				 "\"config\": %s", u->wall, runs,
+				 proc_usage_json(display, sizeof display,
+						 &u->display),
+				 proc_usage_json(client, sizeof client,
+						 &u->client),
+				 perf_str(perf, sizeof perf, u->perf, 1),
+				 bench_config ? bench_config : "{}") < 0)
+		errx(EXIT_FAILURE, "Writing benchmark %s failed", t->name);
+
+	if (!perf_enabled)
+		return;
+
+	snprintf(name, sizeof name, "%s-perf", t->name);
+	if (write_benchmark(name, "%" PRIu64 " %" PRIu64 " %s",
+			    u->wall / NSEC_PER_SEC, u->wall % NSEC_PER_SEC,
+			    perf_str(perf, sizeof perf, u->perf, 0)) < 0)
+		errx(EXIT_FAILURE, "Writing benchmark %s failed", name);
+}
+
+static void
+check_leaks(int64_t cur_blocks, int64_t cur_bytes, int cur_fds)
+{
+	int64_t num_blocks = alloc_tracker_live_blocks();
+	int num_fds;
+
+	if (alloc_report > 0)
+		alloc_tracker_report(stderr, alloc_report);
 
 	if (leak_check_enabled) {
-		if (cur_alloc != num_alloc) {
+		if (cur_blocks != num_blocks) {
 			fprintf(stderr, "Memory leak detected in test. "
-				"Allocated %d blocks, unfreed %d\n", num_alloc,
-				num_alloc - cur_alloc);
+				"Allocated %" PRId64 " blocks, unfreed %" PRId64
+				" (%" PRId64 " bytes)\n", num_blocks,
+				num_blocks - cur_blocks,
+				alloc_tracker_live_bytes() - cur_bytes);
+			alloc_tracker_report_leaks(stderr);
 			abort();
 		}
 		num_fds = count_open_fds();
@@ -155,29 +409,465 @@ run_test(const struct test *t)
 			abort();
 		}
 	}
+}
 
-	/* save benchmark tests */
-	snprintf(bench_name, 255, "benchmarks/%s.benchmark", t->name);
-	f = fopen(bench_name, "a");
-	if (f == NULL)
-		errx(EXIT_FAILURE, "Opening '%s' failed", bench_name);
+/* run test and check for leaks */
+static void
+run_test_once(const struct test *t, struct test_usage *u)
+{
+	int64_t cur_blocks, cur_bytes;
+	int cur_fds;
+	struct timespec start, end;
+	struct perf_counters pc;
+
+	/* open counters before counting fds, so that they're not leaks */
+	if (perf_enabled && perf_counters_open(&pc) == 0)
+		fprintf(stderr, "No performance counter can be opened "
+			"(see /proc/sys/kernel/perf_event_paranoid)\n");
+
+	cur_fds = count_open_fds();
+
+	alloc_tracker_mark();
+	cur_blocks = alloc_tracker_live_blocks();
+	cur_bytes = alloc_tracker_live_bytes();
+
+	if (perf_enabled)
+		perf_counters_enable(&pc);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	t->run();
+	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	head = get_head_commit();
-	ifdbg(head == NULL, "Failed getting HEAD commit\n");
+	if (perf_enabled)
+		perf_counters_disable(&pc);
 
-	if (fprintf(f, "%lu %s %lu %lu\n",
-		    time(NULL), head ? head : "xxx",
-		    end.tv_sec - start.tv_sec,
-                    end.tv_nsec - start.tv_nsec) < 0) {
-		 fclose(f);
-		 errx(EXIT_FAILURE, "Writing to %s failed", bench_name);
+	check_leaks(cur_blocks, cur_bytes, cur_fds);
+
+	get_test_usage(u, timespec_diff_nsec(&start, &end));
+
+	if (perf_enabled) {
+		perf_counters_read(&pc, u->perf);
+		perf_counters_close(&pc);
+	} else {
+		perf_unavailable(u->perf);
 	}
+}
 
-	fclose(f);
+/* run one iteration of benchmark in child process, so that every
+ * iteration starts from the same state. When iteration fails, this
+ * process fails the same way */
+static void
+run_test_iteration(const struct test *t, struct test_usage *u)
+{
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds) < 0)
+		err(EXIT_FAILURE, "pipe failed");
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (pid == 0) {
+		close(fds[0]);
+		run_test_once(t, u);
+
+		if (write(fds[1], u, sizeof *u) != sizeof *u)
+			exit(EXIT_FAILURE);
+
+		exit(EXIT_SUCCESS);
+	}
+
+	close(fds[1]);
+	if (read(fds[0], u, sizeof *u) != sizeof *u)
+		memset(u, 0, sizeof *u);
+	close(fds[0]);
+
+	if (waitpid(pid, &status, 0) < 0)
+		err(EXIT_FAILURE, "waitpid failed");
+
+	if (WIFSIGNALED(status)) {
+		signal(WTERMSIG(status), SIG_DFL);
+		raise(WTERMSIG(status));
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		exit(WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE);
+}
+
+static void
+run_test_bench(const struct test *t)
+{
+	struct wit_stats st;
+	struct test_usage u, mean;
+	uint64_t *samples;
+	char name[255];
+	int i;
+
+	samples = malloc(bench_iterations * sizeof *samples);
+	assert(samples && "Out of memory");
+
+	for (i = 0; i < bench_warmup; i++)
+		run_test_iteration(t, &u);
+
+	memset(&mean, 0, sizeof mean);
+	for (i = 0; i < bench_iterations; i++) {
+		run_test_iteration(t, &u);
+		samples[i] = u.wall;
+		add_proc_usage(&mean.display, &u.display);
+		add_proc_usage(&mean.client, &u.client);
+		add_perf(mean.perf, u.perf);
+	}
+
+	wit_stats_compute(&st, samples, bench_iterations);
+	free(samples);
+
+	div_proc_usage(&mean.display, bench_iterations);
+	div_proc_usage(&mean.client, bench_iterations);
+	for (i = 0; i < PERF_COUNTERS_NO; i++)
+		if (mean.perf[i] != PERF_COUNT_UNAVAILABLE)
+			mean.perf[i] /= bench_iterations;
+
+	fprintf(stderr, "benchmark \"%s\": %d iterations (%d warmup), "
+		"min %.3f ms, median %.3f ms, mean %.3f ms, stddev %.3f ms, "
+		"p90 %.3f ms, p99 %.3f ms\n", t->name, bench_iterations,
+		bench_warmup, st.min / 1e6, st.median / 1e6, st.mean / 1e6,
+		st.stddev / 1e6, st.p90 / 1e6, st.p99 / 1e6);
+
+	/* median is the duration of test in its history */
+	mean.wall = st.median;
+	save_benchmark(t, &mean, bench_iterations);
+
+	snprintf(name, sizeof name, "%s-stats", t->name);
+	if (write_benchmark(name, "%d %" PRIu64 " %" PRIu64 " %.0f %.0f %"
+			    PRIu64 " %" PRIu64, bench_iterations, st.min,
+			    st.median, st.mean, st.stddev, st.p90,
+			    st.p99) < 0)
+		errx(EXIT_FAILURE, "Writing benchmark %s failed", name);
+}
+
+void
+benchmark_start(struct benchmark *b)
+{
+	assertf(!b->running, "Benchmark is already running");
+
+	/* don't count setup of benchmark */
+	if (bench_perf && !b->started)
+		perf_counters_reset(bench_perf);
+	else if (bench_perf)
+		perf_counters_enable(bench_perf);
+
+	b->running = 1;
+	b->started = 1;
+	clock_gettime(CLOCK_MONOTONIC, &b->start);
+}
+
+void
+benchmark_stop(struct benchmark *b)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	assertf(b->running, "Benchmark is not running");
+
+	if (bench_perf)
+		perf_counters_disable(bench_perf);
+
+	b->running = 0;
+	b->elapsed += timespec_diff_nsec(&b->start, &end);
+}
+
+void
+benchmark_set_items(struct benchmark *b, uint64_t items)
+{
+	b->items = items;
+}
+
+void
+benchmark_set_bytes(struct benchmark *b, uint64_t bytes)
+{
+	b->bytes = bytes;
+}
+
+/* call benchmark once, returns time spent in measured region (ns).
+ * Counters (if any) count events of the measured region of this call */
+static uint64_t
+run_benchmark_once(const struct test *t, struct benchmark *b,
+		   uint64_t iterations)
+{
+	struct timespec start, end;
+
+	memset(b, 0, sizeof *b);
+	b->iterations = iterations;
+
+	if (bench_perf) {
+		perf_counters_reset(bench_perf);
+		perf_counters_enable(bench_perf);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	t->bench(b);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (bench_perf)
+		perf_counters_disable(bench_perf);
+
+	assertf(!b->running, "Benchmark \"%s\" didn't stop timing", t->name);
+
+	if (!b->started)
+		b->elapsed = timespec_diff_nsec(&start, &end);
+
+	return b->elapsed;
+}
+
+/* find number of iterations for which the measured region takes
+ * at least bench_duration. The last run is left in b */
+static uint64_t
+calibrate_benchmark(const struct test *t, struct benchmark *b)
+{
+	uint64_t min = (uint64_t) bench_duration * 1000000;
+	uint64_t n = 1, elapsed;
+	double next;
+
+	for (;;) {
+		elapsed = run_benchmark_once(t, b, n);
+		if (elapsed >= min || n >= BENCH_MAX_ITERATIONS)
+			return n;
+
+		/* aim a bit over the duration, but don't jump too far
+		 * from short runs, their time is not reliable */
+		if (elapsed < min / 100)
+			next = n * 100.0;
+		else
+			next = n * 1.2 * min / elapsed + 1;
+
+		n = next > BENCH_MAX_ITERATIONS ? BENCH_MAX_ITERATIONS : next;
+	}
+}
+
+static void
+run_benchmark(const struct test *t)
+{
+	int64_t cur_blocks, cur_bytes;
+	int cur_fds, runs, i;
+	struct timespec start, end;
+	struct benchmark b;
+	struct wit_stats st;
+	struct test_usage u;
+	struct perf_counters pc;
+	uint64_t *samples, n, perf[PERF_COUNTERS_NO];
+	double per_iter, items_ps, bytes_ps;
+	char name[255];
+
+	memset(perf, 0, sizeof perf);
+	if (perf_enabled) {
+		if (perf_counters_open(&pc) == 0)
+			fprintf(stderr, "No performance counter can be opened "
+				"(see /proc/sys/kernel/perf_event_paranoid)\n");
+		bench_perf = &pc;
+	}
+
+	cur_fds = count_open_fds();
+	alloc_tracker_mark();
+	cur_blocks = alloc_tracker_live_blocks();
+	cur_bytes = alloc_tracker_live_bytes();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* calibration is the warmup, with --bench the measurement
+	 * is repeated with the same number of iterations */
+	runs = bench_iterations > 0 ? bench_iterations : 1;
+	samples = malloc(runs * sizeof *samples);
+	assert(samples && "Out of memory");
+
+	n = calibrate_benchmark(t, &b);
+	if (bench_iterations > 0) {
+		for (i = 0; i < runs; i++) {
+			samples[i] = run_benchmark_once(t, &b, n);
+			if (bench_perf) {
+				perf_counters_read(bench_perf, u.perf);
+				add_perf(perf, u.perf);
+			}
+		}
+	} else {
+		samples[0] = b.elapsed;
+		if (bench_perf)
+			perf_counters_read(bench_perf, perf);
+	}
+
+	wit_stats_compute(&st, samples, runs);
+	free(samples);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	check_leaks(cur_blocks, cur_bytes, cur_fds);
+
+	if (bench_perf) {
+		perf_counters_close(bench_perf);
+		bench_perf = NULL;
+	}
+
+	per_iter = (double) st.median / n;
+	items_ps = per_iter > 0 ? b.items * 1e9 / per_iter : 0;
+	bytes_ps = per_iter > 0 ? b.bytes * 1e9 / per_iter : 0;
+
+	fprintf(stderr, "benchmark \"%s\": %" PRIu64 " iterations, %d runs, "
+		"median %.3f ns/iter (min %.3f, stddev %.3f)", t->name, n,
+		runs, per_iter, (double) st.min / n, st.stddev / n);
+	if (b.items)
+		fprintf(stderr, ", %.0f items/s", items_ps);
+	if (b.bytes)
+		fprintf(stderr, ", %.2f MB/s", bytes_ps / (1024 * 1024));
+	for (i = 0; perf_enabled && i < PERF_COUNTERS_NO; i++)
+		if (perf[i] != PERF_COUNT_UNAVAILABLE)
+			fprintf(stderr, ", %.1f %s/iter",
+				(double) perf[i] / (n * runs),
+				perf_counter_names[i]);
+	fprintf(stderr, "\n");
+
+	/* duration of the whole benchmark, for scheduling,
+	 * counts are per iteration of the measured region */
+	get_test_usage(&u, timespec_diff_nsec(&start, &end));
+	perf_unavailable(u.perf);
+	for (i = 0; perf_enabled && i < PERF_COUNTERS_NO; i++)
+		if (perf[i] != PERF_COUNT_UNAVAILABLE)
+			u.perf[i] = perf[i] / (n * runs);
+	save_benchmark(t, &u, 1);
+
+	snprintf(name, sizeof name, "%s-throughput", t->name);
+	if (write_benchmark(name, "%d %" PRIu64 " %.3f %.3f %.3f %.0f %.0f",
+			    runs, n, per_iter, (double) st.min / n,
+			    st.stddev / n, items_ps, bytes_ps) < 0)
+		errx(EXIT_FAILURE, "Writing benchmark %s failed", name);
+}
+
+static void
+run_test(const struct test *t)
+{
+	struct test_usage u;
+
+	if (t->bench) {
+		run_benchmark(t);
+	} else if (bench_iterations > 0) {
+		run_test_bench(t);
+	} else {
+		run_test_once(t, &u);
+		save_benchmark(t, &u, 1);
+	}
 
 	exit(EXIT_SUCCESS);
 }
 
+/* pin this process (and so all tests forked from it) to CPUs given
+ * by list like "0,2-3", returns -1 when list is malformed */
+static int
+pin_to_cpus(const char *list)
+{
+	cpu_set_t set;
+	long from, to;
+	char *end;
+
+	CPU_ZERO(&set);
+
+	do {
+		from = strtol(list, &end, 10);
+		if (end == list || from < 0 || from >= CPU_SETSIZE)
+			return -1;
+
+		to = from;
+		if (*end == '-') {
+			list = end + 1;
+			to = strtol(list, &end, 10);
+			if (end == list || to < from || to >= CPU_SETSIZE)
+				return -1;
+		}
+
+		for (; from <= to; ++from)
+			CPU_SET(from, &set);
+
+		list = end + 1;
+	} while (*end == ',');
+
+	if (*end != '\0')
+		return -1;
+
+	if (sched_setaffinity(0, sizeof set, &set) < 0)
+		err(EXIT_FAILURE, "Pinning to CPUs failed");
+
+	return 0;
+}
+
+static void
+write_json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+
+	for (; *s; ++s) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char) *s < 0x20)
+			fprintf(f, "\\u%04x", *s);
+		else
+			fputc(*s, f);
+	}
+
+	fputc('"', f);
+}
+
+/* configuration that can influence results of benchmarks as JSON object:
+ * options of test-runner and WIT_* environment variables (these configure
+ * tests, e. g. WIT_BENCH_LOAD) */
+static char *
+create_bench_config(int jobs_no, const char *cpus)
+{
+	char *buf = NULL, *name;
+	size_t size;
+	const char *eq;
+	char **env;
+	int first = 1;
+	FILE *f;
+
+	f = open_memstream(&buf, &size);
+	if (f == NULL)
+		err(EXIT_FAILURE, "open_memstream failed");
+
+	fprintf(f, "{\"jobs\": %d, \"bench\": %d, \"warmup\": %d, "
+		"\"duration_ms\": %d, \"leak_check\": %s, \"dbg\": %s, "
+		"\"perf\": %s, \"cpus\": ", jobs_no, bench_iterations,
+		bench_warmup, bench_duration,
+		leak_check_enabled ? "true" : "false",
+		wit_dbg_enabled() ? "true" : "false",
+		perf_enabled ? "true" : "false");
+
+	if (cpus)
+		write_json_string(f, cpus);
+	else
+		fputs("null", f);
+
+	fputs(", \"env\": {", f);
+	for (env = environ; *env; ++env) {
+		eq = strchr(*env, '=');
+		if (strncmp(*env, "WIT_", 4) != 0 || eq == NULL
+		    || strncmp(*env, "WIT_HEAD_COMMIT=", 16) == 0)
+			continue;
+
+		name = strndup(*env, eq - *env);
+		assert(name && "Out of memory");
+
+		fputs(first ? "" : ", ", f);
+		write_json_string(f, name);
+		fputs(": ", f);
+		write_json_string(f, eq + 1);
+
+		free(name);
+		first = 0;
+	}
+	fputs("}}", f);
+
+	if (fclose(f) != 0)
+		err(EXIT_FAILURE, "Creating configuration failed");
+
+	return buf;
+}
+
 /* Print backtrace.
  * Taken from weston */
 #ifdef HAVE_LIBUNWIND
@@ -268,12 +958,363 @@ print_backtrace(int signum)
 }
 #endif /* HAVE_LIBUNWIND */
 
-int main(int argc, char *argv[])
+/* how many last records of benchmark are used for predicting duration */
+#define HISTORY_RECORDS 5
+
+/* predict duration of test (in seconds) from benchmarks/NAME.benchmark,
+ * returns -1 when there's no history */
+static double
+predict_duration(const struct test *t)
 {
+	char path[255];
+	double history[HISTORY_RECORDS], sum = 0;
+	unsigned long timestamp;
+	long sec, nsec;
+	int n = 0, i;
+	FILE *f;
+
+	snprintf(path, sizeof path, "benchmarks/%s.benchmark", t->name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	/* keep the last records in circular buffer */
+	while (fscanf(f, "%lu %*s %ld %ld", &timestamp, &sec, &nsec) == 3)
+		history[n++ % HISTORY_RECORDS] = sec + nsec / 1e9;
+
+	fclose(f);
+
+	if (n == 0)
+		return -1;
+
+	if (n > HISTORY_RECORDS)
+		n = HISTORY_RECORDS;
+
+	for (i = 0; i < n; i++)
+		sum += history[i];
+
+	return sum / n;
+}
+
+/* test running in a child process */
+struct job {
 	const struct test *t;
+	double predicted;	/* duration in seconds */
 	pid_t pid;
-	int total, pass;
-	siginfo_t info;
+	int status;	/* from waitpid() */
+	int done;
+
+	/* read end of pipe with child's stderr (-1 when not buffering) */
+	int fd;
+	FILE *output;
+	char *output_buf;
+	size_t output_size;
+};
+
+static void
+start_job(struct job *j, int buffer)
+{
+	int fds[2];
+
+	if (buffer) {
+		if (pipe2(fds, O_CLOEXEC) < 0) {
+			fprintf(stderr, "pipe failed: %m\n");
+			abort();
+		}
+
+		j->output = open_memstream(&j->output_buf, &j->output_size);
+		assert(j->output && "open_memstream failed");
+	}
+
+	j->pid = fork();
+	assert(j->pid >= 0);
+
+	if (j->pid == 0) {
+		if (buffer) {
+			/* client of test inherits it too */
+			dup2(fds[1], STDERR_FILENO);
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		run_test(j->t); /* never returns */
+	}
+
+	if (buffer) {
+		close(fds[1]);
+		j->fd = fds[0];
+	} else {
+		j->fd = -1;
+	}
+}
+
+/* read output of job, the job is done when the output ends */
+static void
+read_job(struct job *j)
+{
+	char buf[4096];
+	ssize_t len;
+
+	len = read(j->fd, buf, sizeof buf);
+	if (len < 0 && errno == EINTR)
+		return;
+
+	if (len > 0) {
+		fwrite(buf, 1, len, j->output);
+		return;
+	}
+
+	close(j->fd);
+	j->fd = -1;
+
+	if (waitpid(j->pid, &j->status, 0) < 0) {
+		fprintf(stderr, "waitpid failed: %m\n");
+		abort();
+	}
+
+	j->done = 1;
+}
+
+/* print output and result of job, returns 1 when test passed */
+static int
+report_job(struct job *j)
+{
+	int success = 0;
+
+	if (j->output) {
+		fclose(j->output);
+		fwrite(j->output_buf, 1, j->output_size, stderr);
+		free(j->output_buf);
+	}
+
+	fprintf(stderr, "test \"%s\":\t", j->t->name);
+	if (WIFEXITED(j->status)) {
+		fprintf(stderr, "exit status %d", WEXITSTATUS(j->status));
+		if (WEXITSTATUS(j->status) == EXIT_SUCCESS)
+			success = 1;
+	} else if (WIFSIGNALED(j->status)) {
+		fprintf(stderr, "signal %d", WTERMSIG(j->status));
+	}
+
+	if (j->t->must_fail)
+		success = !success;
+
+	if (success)
+		fprintf(stderr, ", pass.\n");
+	else
+		fprintf(stderr, ", fail.\n");
+
+	fprintf(stderr, "---------------------------------------"
+			"-------------------------------------\n");
+
+	return success;
+}
+
+/* predicted duration (in seconds) of test when no test has history */
+#define DEFAULT_DURATION 1.0
+
+/* fill in predicted durations, tests without history
+ * are expected to take average time */
+static void
+predict_jobs(struct job *jobs, int total)
+{
+	double sum = 0, avg;
+	int i, known = 0;
+
+	for (i = 0; i < total; i++) {
+		jobs[i].predicted = predict_duration(jobs[i].t);
+		if (jobs[i].predicted >= 0) {
+			sum += jobs[i].predicted;
+			known++;
+		}
+	}
+
+	/* with zero predictions all tests would end up in one shard */
+	avg = known ? sum / known : DEFAULT_DURATION;
+	if (avg <= 0)
+		avg = DEFAULT_DURATION;
+
+	for (i = 0; i < total; i++)
+		if (jobs[i].predicted < 0)
+			jobs[i].predicted = avg;
+}
+
+/* sort indices of jobs, the longest first, keep order of tests
+ * when prediction is the same (insertion sort, there's few tests) */
+static void
+sort_longest_first(const struct job *jobs, int *order, int n)
+{
+	int i, j, tmp;
+
+	for (i = 1; i < n; i++) {
+		tmp = order[i];
+		for (j = i; j > 0
+		     && jobs[order[j - 1]].predicted < jobs[tmp].predicted; j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+}
+
+/* assign jobs to shards so that shards have similar predicted duration
+ * (the longest job goes to the least loaded shard, from equally loaded
+ * shards the one with fewer jobs) and remove jobs of other shards,
+ * returns number of left jobs */
+static int
+shard_jobs(struct job *jobs, int total, int shard, int shards)
+{
+	double *load;
+	int *order, *owner, *count;
+	int i, j, min, n = 0;
+
+	load = calloc(shards, sizeof *load);
+	count = calloc(shards, sizeof *count);
+	order = calloc(total, sizeof *order);
+	owner = calloc(total, sizeof *owner);
+	assert(load && count && order && owner && "Out of memory");
+
+	for (i = 0; i < total; i++)
+		order[i] = i;
+	sort_longest_first(jobs, order, total);
+
+	for (i = 0; i < total; i++) {
+		min = 0;
+		for (j = 1; j < shards; j++)
+			if (load[j] < load[min]
+			    || (load[j] == load[min] && count[j] < count[min]))
+				min = j;
+
+		owner[order[i]] = min;
+		load[min] += jobs[order[i]].predicted;
+		count[min]++;
+	}
+
+	for (i = 0; i < total; i++)
+		if (owner[i] == shard)
+			jobs[n++] = jobs[i];
+
+	free(owner);
+	free(order);
+	free(count);
+	free(load);
+
+	return n;
+}
+
+/* run all tests (of given shard), at most jobs_no at once,
+ * stores number of run tests into total and returns number of passed
+ * tests */
+static int
+run_tests(int jobs_no, int shard, int shards, int *total_out)
+{
+	struct job *jobs;
+	struct pollfd *fds;
+	int *polled, *order;
+	int total, started = 0, reported = 0, running = 0, pass = 0;
+	int i, n, status;
+	int buffer = jobs_no > 1;
+	pid_t pid;
+
+	total = &__stop_test_section - &__start_test_section;
+
+	jobs = calloc(total, sizeof *jobs);
+	order = calloc(total, sizeof *order);
+	fds = calloc(jobs_no, sizeof *fds);
+	polled = calloc(jobs_no, sizeof *polled);
+	assert(jobs && order && fds && polled && "Out of memory");
+
+	for (i = 0; i < total; i++)
+		jobs[i].t = &__start_test_section + i;
+
+	if (jobs_no > 1 || shards > 1)
+		predict_jobs(jobs, total);
+
+	if (shards > 1)
+		total = shard_jobs(jobs, total, shard, shards);
+
+	/* start the longest tests first, so that they don't
+	 * prolong the run when started at the end */
+	for (i = 0; i < total; i++)
+		order[i] = i;
+	if (jobs_no > 1)
+		sort_longest_first(jobs, order, total);
+
+	while (reported < total) {
+		while (running < jobs_no && started < total) {
+			start_job(&jobs[order[started++]], buffer);
+			running++;
+		}
+
+		if (buffer) {
+			n = 0;
+			for (i = 0; i < total; i++) {
+				if (jobs[i].pid == 0 || jobs[i].fd < 0)
+					continue;
+
+				fds[n].fd = jobs[i].fd;
+				fds[n].events = POLLIN;
+				polled[n] = i;
+				n++;
+			}
+
+			if (poll(fds, n, -1) < 0) {
+				assert(errno == EINTR && "poll failed");
+				continue;
+			}
+
+			for (i = 0; i < n; i++) {
+				if (fds[i].revents == 0)
+					continue;
+
+				read_job(&jobs[polled[i]]);
+				if (jobs[polled[i]].done)
+					running--;
+			}
+		} else {
+			pid = waitpid(-1, &status, 0);
+			if (pid < 0) {
+				fprintf(stderr, "waitpid failed: %m\n");
+				abort();
+			}
+
+			for (i = 0; i < total; i++) {
+				if (jobs[i].pid == pid) {
+					jobs[i].status = status;
+					jobs[i].done = 1;
+					running--;
+				}
+			}
+		}
+
+		/* results are reported in order of tests */
+		while (reported < total && jobs[reported].done)
+			pass += report_job(&jobs[reported++]);
+	}
+
+	free(polled);
+	free(fds);
+	free(order);
+	free(jobs);
+
+	*total_out = total;
+
+	return pass;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct test *t;
+	const char *cpus;
+	int total, pass, opt;
+	int jobs_no = 1, shard = 0, shards = 1;
+	static const struct option options[] = {
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "shard", required_argument, NULL, 's' },
+		{ "bench", required_argument, NULL, 'b' },
+		{ "warmup", required_argument, NULL, 'w' },
+		{ "cpu", required_argument, NULL, 'c' },
+		{ "perf", no_argument, NULL, 'p' },
+		{ NULL, 0, NULL, 0 }
+	};
 
 	/* print backtrace upon SIGSEGV */
 	signal(SIGSEGV, print_backtrace);
@@ -285,62 +1326,86 @@ int main(int argc, char *argv[])
 	sys_free = dlsym(RTLD_NEXT, "free");
 
 	leak_check_enabled = !getenv("NO_ASSERT_LEAK_CHECK");
+	if (getenv("WIT_ALLOC_REPORT"))
+		alloc_report = atoi(getenv("WIT_ALLOC_REPORT"));
+
+	/* benchmarks run without tracking, it costs a lot */
+	if ((leak_check_enabled || alloc_report > 0)
+	    && alloc_tracker_init() < 0) {
+		warnx("Can not track allocations, leak check disabled");
+		leak_check_enabled = 0;
+		alloc_report = 0;
+	}
 
 	if (argc == 2 && strcmp(argv[1], "--help") == 0)
 		usage(argv[0], EXIT_SUCCESS);
 
-	if (argc == 2) {
-		t = find_test(argv[1]);
-		if (t == NULL) {
-			fprintf(stderr, "unknown test: \"%s\"\n", argv[1]);
+	if (getenv("WIT_BENCH_ITERATIONS"))
+		bench_iterations = atoi(getenv("WIT_BENCH_ITERATIONS"));
+	if (getenv("WIT_BENCH_WARMUP"))
+		bench_warmup = atoi(getenv("WIT_BENCH_WARMUP"));
+	if (getenv("WIT_BENCH_DURATION"))
+		bench_duration = atoi(getenv("WIT_BENCH_DURATION"));
+	cpus = getenv("WIT_BENCH_CPU");
+	perf_enabled = getenv("WIT_PERF") != NULL;
+
+	while ((opt = getopt_long(argc, argv, "j:", options, NULL)) != -1) {
+		switch (opt) {
+		case 'b':
+			bench_iterations = atoi(optarg);
+			break;
+		case 'w':
+			bench_warmup = atoi(optarg);
+			break;
+		case 'c':
+			cpus = optarg;
+			break;
+		case 'p':
+			perf_enabled = 1;
+			break;
+		case 's':
+			if (sscanf(optarg, "%d/%d", &shard, &shards) != 2
+			    || shards < 1 || shard < 0 || shard >= shards)
+				usage(argv[0], EXIT_FAILURE);
+			break;
+		case 'j':
+			jobs_no = atoi(optarg);
+			if (jobs_no == 0)
+				jobs_no = sysconf(_SC_NPROCESSORS_ONLN);
+			if (jobs_no < 1)
+				usage(argv[0], EXIT_FAILURE);
+			break;
+		default:
 			usage(argv[0], EXIT_FAILURE);
 		}
-
-		run_test(t);
 	}
 
-	pass = 0;
-	for (t = &__start_test_section; t < &__stop_test_section; t++) {
-		int success = 0;
+	if (bench_iterations < 0 || bench_warmup < 0 || bench_duration < 0)
+		usage(argv[0], EXIT_FAILURE);
 
-		pid = fork();
-		assert(pid >= 0);
+	if (cpus && pin_to_cpus(cpus) < 0)
+		usage(argv[0], EXIT_FAILURE);
 
-		if (pid == 0)
-			run_test(t); /* never returns */
+	bench_config = create_bench_config(jobs_no, cpus);
 
-		if (waitid(P_ALL, 0, &info, WEXITED)) {
-			fprintf(stderr, "waitid failed: %m\n");
-			abort();
-		}
+	/* resolve HEAD once, tests inherit it */
+	ifdbg(get_head_commit() == NULL, "Failed getting HEAD commit\n");
 
-		fprintf(stderr, "test \"%s\":\t", t->name);
-		switch (info.si_code) {
-		case CLD_EXITED:
-			fprintf(stderr, "exit status %d", info.si_status);
-			if (info.si_status == EXIT_SUCCESS)
-				success = 1;
-			break;
-		case CLD_KILLED:
-		case CLD_DUMPED:
-			fprintf(stderr, "signal %d", info.si_status);
-			break;
+	if (argc - optind == 1) {
+		t = find_test(argv[optind]);
+		if (t == NULL) {
+			fprintf(stderr, "unknown test: \"%s\"\n", argv[optind]);
+			usage(argv[0], EXIT_FAILURE);
 		}
 
-		if (t->must_fail)
-			success = !success;
-
-		if (success) {
-			pass++;
-			fprintf(stderr, ", pass.\n");
-		} else
-			fprintf(stderr, ", fail.\n");
-
-		fprintf(stderr, "---------------------------------------"
-				"-------------------------------------\n");
+		run_test(t);
+	} else if (argc - optind > 1) {
+		usage(argv[0], EXIT_FAILURE);
 	}
 
-	total = &__stop_test_section - &__start_test_section;
+	pass = run_tests(jobs_no, shard, shards, &total);
+	free(bench_config);
+
 	fprintf(stderr, "%d tests, %d pass, %d fail\n",
 		total, pass, total - pass);
 
@@ -1,21 +1,45 @@
 #ifndef _TEST_RUNNER_H_
 #define _TEST_RUNNER_H_
 
+#include <sys/types.h>
+#include <stdint.h>
+#include <time.h>
+
 #ifdef NDEBUG
 #error "Tests must not be built with NDEBUG defined, they rely on assert()."
 #endif
 
+struct benchmark;
+
 struct test {
 	const char *name;
 	void (*run)(void);
 	int must_fail;
+	void (*bench)(struct benchmark *);
 } __attribute__ ((aligned (16)));
 
+/* Benchmark binaries (test/benchmarks, make bench) are built from the same
+ * sources as tests with WIT_BENCHMARK_BUILD defined. Only BENCHMARKs and
+ * BENCHMARK_TESTs are registered in them, while test binaries (make check)
+ * register only TESTs and FAIL_TESTs. The others are compiled anyway,
+ * so that they don't rot. */
+#define WIT_REGISTERED_ENTRY					\
+	const struct test __attribute__ ((section ("test_section")))
+#define WIT_UNREGISTERED_ENTRY					\
+	static const struct test __attribute__ ((unused))
+
+#ifdef WIT_BENCHMARK_BUILD
+#define WIT_TEST_ENTRY		WIT_UNREGISTERED_ENTRY
+#define WIT_BENCHMARK_ENTRY	WIT_REGISTERED_ENTRY
+#else
+#define WIT_TEST_ENTRY		WIT_REGISTERED_ENTRY
+#define WIT_BENCHMARK_ENTRY	WIT_UNREGISTERED_ENTRY
+#endif
+
 #define TEST(name)						\
 	static void name(void);					\
 								\
-	const struct test test##name				\
-		 __attribute__ ((section ("test_section"))) = {	\
+	WIT_TEST_ENTRY test##name = {				\
 		#name, name, 0					\
 	};							\
 								\
@@ -24,13 +48,91 @@ struct test {
 #define FAIL_TEST(name)						\
 	static void name(void);					\
 								\
-	const struct test test##name				\
-		 __attribute__ ((section ("test_section"))) = {	\
+	WIT_TEST_ENTRY test##name = {				\
 		#name, name, 1					\
 	};							\
 								\
 	static void name(void)
 
+/* test that measures something (and saves it into benchmarks/ itself),
+ * it is run only by make bench */
+#define BENCHMARK_TEST(name)					\
+	static void name(void);					\
+								\
+	WIT_BENCHMARK_ENTRY test##name = {			\
+		#name, name, 0					\
+	};							\
+								\
+	static void name(void)
+
+/**
+ * State of one run of benchmark
+ *
+ * Benchmark does b->iterations iterations of the measured code. The runner
+ * calls it repeatedly with growing number of iterations until the measured
+ * region takes at least WIT_BENCH_DURATION milliseconds (200 by default),
+ * so benchmark must not depend on how many times it is called.
+ *
+ * Only time between benchmark_start() and benchmark_stop() is measured
+ * (these can be called more times to exclude setup of every iteration).
+ * When benchmark doesn't call them, whole the run is measured.
+ */
+struct benchmark {
+	uint64_t iterations;	/* to be done by benchmark */
+
+	/* set by benchmark_set_items() and benchmark_set_bytes() */
+	uint64_t items;
+	uint64_t bytes;
+
+	/* time spent in measured region so far (ns) */
+	uint64_t elapsed;
+	struct timespec start;
+	int running;
+	int started;
+};
+
+/**
+ * Define benchmark. The body gets struct benchmark *b:
+ *
+ *	BENCHMARK(foo_bench)
+ *	{
+ *		uint64_t i;
+ *
+ *		setup();
+ *
+ *		benchmark_start(b);
+ *		for (i = 0; i < b->iterations; ++i)
+ *			foo();
+ *		benchmark_stop(b);
+ *
+ *		benchmark_set_items(b, 1);
+ *		cleanup();
+ *	}
+ */
+#define BENCHMARK(name)						\
+	static void name(struct benchmark *b);			\
+								\
+	WIT_BENCHMARK_ENTRY test##name = {			\
+		#name, NULL, 0, name				\
+	};							\
+								\
+	static void name(struct benchmark *b)
+
+void
+benchmark_start(struct benchmark *b);
+
+void
+benchmark_stop(struct benchmark *b);
+
+/* items (events, requests, ...) processed in one iteration, the runner
+ * reports items per second */
+void
+benchmark_set_items(struct benchmark *b, uint64_t items);
+
+/* bytes processed in one iteration, the runner reports bytes per second */
+void
+benchmark_set_bytes(struct benchmark *b, uint64_t bytes);
+
 int
 count_open_fds(void);
 
@@ -40,4 +142,20 @@ print_open_fds(void);
 const char *
 get_head_commit(void);
 
+/* append record "timestamp commit ..." into benchmarks/name.benchmark,
+ * returns 0 on success, -1 on error */
+int
+write_benchmark(const char *name, const char *fmt, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+/* append JSON record {"timestamp": ..., "commit": ..., "name": ..., FIELDS}
+ * into benchmarks/name.jsonl, fmt gives FIELDS (without braces),
+ * returns 0 on success, -1 on error */
+int
+write_benchmark_json(const char *name, const char *fmt, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+int
+create_anonymous_file(off_t size);
+
 #endif
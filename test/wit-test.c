@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-client.h>
 
 #include "test-runner.h"
@@ -325,3 +326,96 @@ TEST(test_operations_tst)
 }
 
 
+
+static long
+msec_since(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000
+		+ (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static int
+latency_ack_main(int sock)
+{
+	struct timespec start;
+	long msec;
+	struct wit_client *c = wit_client_populate(sock);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	wit_client_barrier(c);
+	msec = msec_since(&start);
+
+	assertf(msec >= 50, "Barrier was acknowledged too early (%ld ms)", msec);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(latency_ack_tst)
+{
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL, 0};
+	conf.latency.ack_delay = 50000;
+
+	struct wit_display *d = wit_display_create(&conf);
+	assertf(d->latency.source, "Latency timer wasn't created");
+
+	wit_display_create_client(d, latency_ack_main);
+	wit_display_run(d);
+	wit_display_barrier(d);
+
+	wit_display_destroy(d);
+}
+
+WIT_EVENT_DEFINE_GLOBAL(motion_e, &wl_pointer_interface, WL_POINTER_MOTION);
+
+static int
+latency_rate_main(int sock)
+{
+	struct timespec start;
+	long msec;
+	struct wit_client *c = wit_client_populate(sock);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	wit_client_ask_for_events(c, 0);
+	msec = msec_since(&start);
+
+	/* 20 events at 200 events per second = 19 intervals of 5 ms */
+	assertf(msec >= 95, "Events were emitted too fast (%ld ms)", msec);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(latency_rate_tst)
+{
+	int i;
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL, 0};
+	conf.latency.max_event_rate = 200;
+
+	struct wit_eventarray *ea = wit_eventarray_create();
+	struct wit_display *d = wit_display_create(&conf);
+
+	for (i = 0; i < 20; i++)
+		wit_eventarray_add(ea, DISPLAY, motion_e, i, i, i);
+
+	wit_display_add_events(d, ea);
+	wit_display_create_client(d, latency_rate_main);
+	wit_display_run(d);
+	wit_display_emit_events(d);
+
+	wit_display_destroy(d);
+}
+
+TEST(latency_none_tst)
+{
+	struct wit_display *d = wit_display_create(NULL);
+
+	/* no latency configured, no timer */
+	assert(d->latency.source == NULL);
+	assert(d->latency.fd == -1);
+
+	wit_display_destroy(d);
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <linux/input-event-codes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server.h>
+
+#include "test-runner.h"
+#include "wit.h"
+
+struct keyboard_state {
+	int keymap, enter, leave, modifiers, repeat_info;
+	int pressed, released;
+	uint32_t depressed;		/* last modifiers */
+	uint32_t keys[20];		/* pressed keys (without shift) */
+	uint32_t press_time[20];
+	uint32_t release_time[20];
+	int count;
+};
+
+static void
+keyboard_handle_keymap(void *data, struct wl_keyboard *keyboard,
+		       uint32_t format, int32_t fd, uint32_t size)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+	char *map;
+
+	assert(format == WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1);
+	assert(size == strlen(wit_default_keymap) + 1);
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	assertf(map != MAP_FAILED, "Mapping keymap failed");
+	assert(map[size - 1] == '\0');
+	assert(strcmp(map, wit_default_keymap) == 0);
+	munmap(map, size);
+
+#if defined(HAVE_MEMFD_CREATE) && defined(F_GET_SEALS)
+	int seals = fcntl(fd, F_GET_SEALS);
+	assertf(seals & F_SEAL_WRITE, "Keymap is not sealed");
+#endif
+
+	close(fd);
+	ks->keymap++;
+}
+
+static void
+keyboard_handle_enter(void *data, struct wl_keyboard *keyboard,
+		      uint32_t serial, struct wl_surface *surface,
+		      struct wl_array *keys)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+
+	assert(surface);
+	assert(keys->size == 0);
+	ks->enter++;
+}
+
+static void
+keyboard_handle_leave(void *data, struct wl_keyboard *keyboard,
+		      uint32_t serial, struct wl_surface *surface)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+
+	ks->leave++;
+}
+
+static void
+keyboard_handle_key(void *data, struct wl_keyboard *keyboard,
+		    uint32_t serial, uint32_t time, uint32_t key,
+		    uint32_t state)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+
+	if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+		ks->pressed++;
+
+		if (key == KEY_LEFTSHIFT)
+			return;
+
+		assert(ks->count < 20);
+		ks->keys[ks->count] = key;
+		ks->press_time[ks->count] = time;
+	} else {
+		ks->released++;
+
+		if (key == KEY_LEFTSHIFT)
+			return;
+
+		assertf(ks->keys[ks->count] == key,
+			"Released other key than pressed");
+		ks->release_time[ks->count] = time;
+		ks->count++;
+	}
+}
+
+static void
+keyboard_handle_modifiers(void *data, struct wl_keyboard *keyboard,
+			  uint32_t serial, uint32_t depressed,
+			  uint32_t latched, uint32_t locked, uint32_t group)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+
+	ks->depressed = depressed;
+	ks->modifiers++;
+}
+
+#ifdef WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION
+static void
+keyboard_handle_repeat_info(void *data, struct wl_keyboard *keyboard,
+			    int32_t rate, int32_t delay)
+{
+	struct keyboard_state *ks = ((struct wit_client *) data)->data;
+
+	assert(rate == 30);
+	assert(delay == 500);
+	ks->repeat_info++;
+}
+#endif
+
+static const struct wl_keyboard_listener keyboard_listener = {
+	keyboard_handle_keymap,
+	keyboard_handle_enter,
+	keyboard_handle_leave,
+	keyboard_handle_key,
+	keyboard_handle_modifiers,
+#ifdef WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION
+	keyboard_handle_repeat_info
+#endif
+};
+
+static int
+keymap_main(int sock)
+{
+	struct keyboard_state ks;
+	struct wit_client *c = wit_client_populate(sock);
+
+	memset(&ks, 0, sizeof ks);
+	c->data = &ks;
+
+	/* keyboard doesn't exist yet, listener will be added right after
+	 * creating it, so we won't miss the keymap */
+	wit_client_add_listener(c, "wl_keyboard", &keyboard_listener);
+
+	/* get capabilities and create keyboard, then get the keymap */
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+
+	assertf(ks.keymap == 1, "Got %d keymaps", ks.keymap);
+	assert(ks.modifiers == 1 && ks.depressed == 0);
+
+#ifdef WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION
+	if (wl_proxy_get_version((struct wl_proxy *) c->keyboard.proxy)
+	    >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION)
+		assert(ks.repeat_info == 1);
+#endif
+
+	wit_client_barrier(c);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(keymap_tst)
+{
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL,
+				  CONF_OPT_KEYMAP};
+	struct wit_display *d;
+
+	conf.keyboard.repeat_rate = 30;
+	conf.keyboard.repeat_delay = 500;
+
+	d = wit_display_create(&conf);
+	assert(d->keyboard.keymap_fd == -1);
+
+	wit_display_create_client(d, keymap_main);
+	wit_display_run(d);
+	wit_display_barrier(d);
+
+	assertf(d->keyboard.keymap_fd >= 0, "Keymap wasn't created");
+	assert(d->keyboard.keymap_size == strlen(wit_default_keymap) + 1);
+
+	wit_display_destroy(d);
+}
+
+static int
+typing_main(int sock)
+{
+	struct keyboard_state ks;
+	struct wit_client *c = wit_client_populate(sock);
+	struct wl_surface *surface
+				= wl_compositor_create_surface(
+					(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	memset(&ks, 0, sizeof ks);
+	c->data = &ks;
+	wit_client_add_listener(c, "wl_keyboard", &keyboard_listener);
+
+	/* make sure display has created keyboard resource */
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+	wit_client_barrier(c);
+
+	wit_client_ask_for_events(c, 0);
+	wl_display_roundtrip(c->display);
+
+	assert(ks.enter == 1 && ks.leave == 1);
+	assert(ks.keymap == 0);
+
+	/* "Hi!\n" + held 'a', 'H' and '!' with shift */
+	assertf(ks.pressed == 7, "Got %d key presses", ks.pressed);
+	assertf(ks.released == 7, "Got %d key releases", ks.released);
+	/* enter + shift down and up twice */
+	assertf(ks.modifiers == 5, "Got %d modifiers", ks.modifiers);
+	assert(ks.depressed == 0);
+
+	assert(ks.count == 5);
+	assert(ks.keys[0] == KEY_H);
+	assert(ks.keys[1] == KEY_I);
+	assert(ks.keys[2] == KEY_1);
+	assert(ks.keys[3] == KEY_ENTER);
+	assert(ks.keys[4] == KEY_A);
+
+	/* 1000 steps per second, 'a' is held 50 steps */
+	assertf(ks.release_time[0] - ks.press_time[0] == 1,
+		"Wrong time stamps");
+	assertf(ks.release_time[4] - ks.press_time[4] == 51,
+		"Key wasn't held (%u ms)",
+		ks.release_time[4] - ks.press_time[4]);
+
+	wl_surface_destroy(surface);
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(typing_tst)
+{
+	struct wit_typing typing;
+	struct wit_display *d = wit_display_create(NULL);
+
+	memset(&typing, 0, sizeof typing);
+	typing.text = "Hi!\n";
+	typing.wpm = 6000;
+	typing.repeat_key = 'a';
+	typing.repeat_hold = 50;
+
+	wit_display_create_client(d, typing_main);
+	wit_display_run(d);
+
+	/* wait for client to create surface */
+	wit_display_barrier(d);
+
+	wit_display_add_generator(d, wit_keyboard_generator_create(&typing));
+	wit_display_emit_events(d);
+
+	assertf(d->generator == NULL, "Generator should be exhausted");
+
+	wit_display_destroy(d);
+}
+
+TEST(keycode_tst)
+{
+	int shift;
+
+	assert(wit_keycode_from_char('a', &shift) == KEY_A && !shift);
+	assert(wit_keycode_from_char('A', &shift) == KEY_A && shift);
+	assert(wit_keycode_from_char('0', &shift) == KEY_0 && !shift);
+	assert(wit_keycode_from_char(')', &shift) == KEY_0 && shift);
+	assert(wit_keycode_from_char('/', &shift) == KEY_SLASH && !shift);
+	assert(wit_keycode_from_char('?', &shift) == KEY_SLASH && shift);
+	assert(wit_keycode_from_char('`', &shift) == KEY_GRAVE && !shift);
+	assert(wit_keycode_from_char('|', &shift) == KEY_BACKSLASH && shift);
+	assert(wit_keycode_from_char(' ', &shift) == KEY_SPACE && !shift);
+	assert(wit_keycode_from_char('\n', &shift) == KEY_ENTER);
+
+	/* not on us keyboard */
+	assert(wit_keycode_from_char('\x01', &shift) == 0);
+}
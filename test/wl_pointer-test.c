@@ -21,6 +21,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <wayland-client.h>
 #include <wayland-server.h>
 
@@ -175,3 +176,282 @@ TEST(pointer_each_once_tst)
 	wit_display_destroy(d);
 }
 /* TODO create more sophisticated tests */
+
+/* -----------------------------------------------------------------------------
+    Pointer generator
+   -------------------------------------------------------------------------- */
+#define GEN_SAMPLES 100
+#define GEN_BUTTON 0x110 /* BTN_LEFT */
+
+struct generated {
+	int enter, leave, motion, press, release, frame;
+	uint32_t first_time, last_time, prev_time;
+	uint32_t last_serial;
+	wl_fixed_t x, y;
+	wl_fixed_t max_step;	/* the longest move in one axis */
+};
+
+static void
+gen_handle_enter(void *data, struct wl_pointer *pointer, uint32_t serial,
+		 struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+{
+	struct generated *g = ((struct wit_client *) data)->data;
+
+	assert(surface);
+	g->enter++;
+	g->last_serial = serial;
+	g->x = x;
+	g->y = y;
+}
+
+static void
+gen_handle_leave(void *data, struct wl_pointer *pointer, uint32_t serial,
+		 struct wl_surface *surface)
+{
+	struct generated *g = ((struct wit_client *) data)->data;
+
+	assertf(serial > g->last_serial, "Serial didn't grow");
+	g->leave++;
+}
+
+static void
+gen_handle_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+		  wl_fixed_t x, wl_fixed_t y)
+{
+	struct generated *g = ((struct wit_client *) data)->data;
+
+	if (g->motion == 0)
+		g->first_time = time;
+	else
+		assertf(time >= g->prev_time, "Time goes backwards");
+
+	if (abs(x - g->x) > g->max_step)
+		g->max_step = abs(x - g->x);
+	if (abs(y - g->y) > g->max_step)
+		g->max_step = abs(y - g->y);
+
+	g->prev_time = g->last_time = time;
+	g->x = x;
+	g->y = y;
+	g->motion++;
+}
+
+static void
+gen_handle_button(void *data, struct wl_pointer *pointer, uint32_t serial,
+		  uint32_t time, uint32_t button, uint32_t state)
+{
+	struct generated *g = ((struct wit_client *) data)->data;
+
+	assert(button == GEN_BUTTON);
+	assertf(serial > g->last_serial, "Serial didn't grow");
+	g->last_serial = serial;
+
+	if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
+		assertf(g->motion == 0, "Button pressed after motion");
+		g->press++;
+	} else {
+		assertf(g->motion == GEN_SAMPLES, "Button released too early");
+		assertf(time == g->last_time,
+			"Release doesn't have time of last motion");
+		g->release++;
+	}
+}
+
+#ifdef WL_POINTER_FRAME_SINCE_VERSION
+static void
+gen_handle_frame(void *data, struct wl_pointer *pointer)
+{
+	struct generated *g = ((struct wit_client *) data)->data;
+
+	g->frame++;
+}
+#endif
+
+static const struct wl_pointer_listener gen_listener = {
+	gen_handle_enter,
+	gen_handle_leave,
+	gen_handle_motion,
+	gen_handle_button,
+	pointer_handle_axis,
+#ifdef WL_POINTER_FRAME_SINCE_VERSION
+	gen_handle_frame
+#endif
+};
+
+static int
+pointer_generator_main(int sock)
+{
+	struct generated g;
+	struct wit_client *c = wit_client_populate(sock);
+	struct wl_surface *surface
+				= wl_compositor_create_surface(
+					(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	memset(&g, 0, sizeof g);
+	c->data = &g;
+	wit_client_add_listener(c, "wl_pointer", &gen_listener);
+
+	/* first roundtrip gets capabilities and creates pointer,
+	 * second makes sure display has created the pointer resource */
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+	wit_client_barrier(c);
+
+	wit_client_ask_for_events(c, 0);
+	wl_display_roundtrip(c->display);
+
+	assert(g.enter == 1 && g.leave == 1);
+	assert(g.press == 1 && g.release == 1);
+	assertf(g.motion == GEN_SAMPLES, "Got %d motion events", g.motion);
+
+	/* 1000 Hz */
+	assertf(g.last_time - g.first_time == GEN_SAMPLES - 1,
+		"Wrong time stamps (%u - %u)", g.first_time, g.last_time);
+
+	assert(g.x == wl_fixed_from_int(99) && g.y == wl_fixed_from_int(198));
+
+#ifdef WL_POINTER_FRAME_SINCE_VERSION
+	if (wl_proxy_get_version((struct wl_proxy *) c->pointer.proxy)
+	    >= WL_POINTER_FRAME_SINCE_VERSION)
+		assertf(g.frame == GEN_SAMPLES + 4, "Got %d frames", g.frame);
+	else
+		assert(g.frame == 0);
+#endif
+
+	wl_surface_destroy(surface);
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(pointer_generator_tst)
+{
+	struct wit_pointer_path path;
+	struct wit_display *d = wit_display_create(NULL);
+
+	memset(&path, 0, sizeof path);
+	path.type = WIT_PATH_LINE;
+	path.rate = 1000;
+	path.samples = GEN_SAMPLES;
+	path.to.x = 99;
+	path.to.y = 198;
+	path.button = GEN_BUTTON;
+
+	wit_display_create_client(d, pointer_generator_main);
+	wit_display_run(d);
+
+	/* wait for client to create surface */
+	wit_display_barrier(d);
+
+	wit_display_add_generator(d, wit_pointer_generator_create(&path));
+	wit_display_emit_events(d);
+
+	assertf(d->generator == NULL, "Generator should be exhausted");
+
+	wit_display_destroy(d);
+}
+
+#define WALK_FROM 100
+#define WALK_STEP 5
+
+static int
+pointer_random_walk_main(int sock)
+{
+	struct generated g;
+	struct wit_client *c = wit_client_populate(sock);
+	struct wl_surface *surface
+				= wl_compositor_create_surface(
+					(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	memset(&g, 0, sizeof g);
+	c->data = &g;
+	wit_client_add_listener(c, "wl_pointer", &gen_listener);
+
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+	wit_client_barrier(c);
+
+	wit_client_ask_for_events(c, 0);
+	wl_display_roundtrip(c->display);
+
+	assert(g.enter == 1 && g.leave == 1);
+	assertf(g.motion == GEN_SAMPLES, "Got %d motion events", g.motion);
+
+	/* enter is at the starting point, every sample moves at most by
+	 * step (+ rounding to wl_fixed_t) */
+	assertf(g.max_step <= wl_fixed_from_int(WALK_STEP) + 1,
+		"Pointer moved by %f", wl_fixed_to_double(g.max_step));
+	assert(abs(g.x - wl_fixed_from_int(WALK_FROM))
+	       <= wl_fixed_from_int(GEN_SAMPLES * WALK_STEP));
+
+	wl_surface_destroy(surface);
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(pointer_random_walk_tst)
+{
+	struct wit_pointer_path path;
+	struct wit_display *d = wit_display_create(NULL);
+
+	memset(&path, 0, sizeof path);
+	path.type = WIT_PATH_RANDOM_WALK;
+	path.rate = 1000;
+	path.samples = GEN_SAMPLES;
+	path.from.x = WALK_FROM;
+	path.from.y = WALK_FROM;
+	path.step = WALK_STEP;
+	path.seed = 1;
+
+	wit_display_create_client(d, pointer_random_walk_main);
+	wit_display_run(d);
+
+	/* wait for client to create surface, so that the pointer enters it */
+	wit_display_barrier(d);
+
+	wit_display_add_generator(d, wit_pointer_generator_create(&path));
+	wit_display_emit_events(d);
+
+	assertf(d->generator == NULL, "Generator should be exhausted");
+
+	wit_display_destroy(d);
+}
+
+TEST(pointer_path_tst)
+{
+	struct wit_pointer_path path;
+	struct wit_point p;
+
+	memset(&path, 0, sizeof path);
+	path.samples = 5;
+
+	path.type = WIT_PATH_BEZIER;
+	path.from.x = 10;
+	path.c1.x = 20;
+	path.c1.y = 100;
+	path.c2.x = 30;
+	path.c2.y = 100;
+	path.to.x = 40;
+
+	/* bezier goes through its end points */
+	p = wit_pointer_path_point(&path, 0);
+	assert(p.x == 10 && p.y == 0);
+	p = wit_pointer_path_point(&path, 4);
+	assert(p.x == 40 && p.y == 0);
+	/* middle of symmetric curve */
+	p = wit_pointer_path_point(&path, 2);
+	assert(p.x == 25 && p.y == 75);
+
+	path.type = WIT_PATH_CIRCLE;
+	path.samples = 4;
+	path.center.x = 50;
+	path.center.y = 50;
+	path.radius = 10;
+
+	p = wit_pointer_path_point(&path, 0);
+	assert(p.x == 60 && p.y == 50);
+	p = wit_pointer_path_point(&path, 2);
+	assert(p.x > 39.999 && p.x < 40.001);
+	assert(p.y > 49.999 && p.y < 50.001);
+}
@@ -20,8 +20,15 @@
  * OF THIS SOFTWARE.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <wayland-server.h>
 #include <wayland-client.h>
@@ -35,16 +42,27 @@
 struct wl_dummy;
 
 const struct wl_interface dummy_interface;
+extern const struct wl_interface wl_dummy_interface;
 const struct wl_interface *types[] = {
 	NULL,
 	&dummy_interface,
+	&wl_dummy_interface,
 };
 
 static const struct wl_message dummy_requests[] = {
 	{ "request_empty", "",  types + 0},
 	{ "request_i", "i",  types + 0},
 	{ "request_s", "s",  types + 1},
-	/* TODO fill in other types */
+
+	/* used by dispatch benchmark, one for each type of argument */
+	{ "bench_i", "i", types + 0},
+	{ "bench_u", "u", types + 0},
+	{ "bench_f", "f", types + 0},
+	{ "bench_s", "s", types + 0},
+	{ "bench_o", "o", types + 2},
+	{ "bench_n", "n", types + 2},
+	{ "bench_a", "a", types + 0},
+	{ "bench_h", "h", types + 0},
 };
 
 static const struct wl_message dummy_events[] = {
@@ -55,10 +73,11 @@ static const struct wl_message dummy_events[] = {
 
 #define EVENTS_NO 3
 #define REQUESTS_NO 3
+#define BENCH_REQUESTS_NO 8
 const struct wl_interface wl_dummy_interface = {
 	"wl_dummy", 1,
-	EVENTS_NO, dummy_requests,
-	REQUESTS_NO, dummy_events,
+	REQUESTS_NO + BENCH_REQUESTS_NO, dummy_requests,
+	EVENTS_NO, dummy_events,
 };
 
 struct wl_dummy_interface {
@@ -66,6 +85,23 @@ struct wl_dummy_interface {
 	void (*request_i) (struct wl_client *client, struct wl_resource *resource, int i);
 	void (*request_s) (struct wl_client *client, struct wl_resource *resource,
 			   const char *s);
+
+	void (*bench_i) (struct wl_client *client, struct wl_resource *resource,
+			 int32_t i);
+	void (*bench_u) (struct wl_client *client, struct wl_resource *resource,
+			 uint32_t u);
+	void (*bench_f) (struct wl_client *client, struct wl_resource *resource,
+			 wl_fixed_t f);
+	void (*bench_s) (struct wl_client *client, struct wl_resource *resource,
+			 const char *s);
+	void (*bench_o) (struct wl_client *client, struct wl_resource *resource,
+			 struct wl_resource *o);
+	void (*bench_n) (struct wl_client *client, struct wl_resource *resource,
+			 uint32_t id);
+	void (*bench_a) (struct wl_client *client, struct wl_resource *resource,
+			 struct wl_array *a);
+	void (*bench_h) (struct wl_client *client, struct wl_resource *resource,
+			 int32_t fd);
 };
 
 struct wl_dummy_listener {
@@ -86,8 +122,17 @@ enum {
 	DUMMY_REQUEST_empty = 0,
 	DUMMY_REQUEST_i,
 	DUMMY_REQUEST_s,
+	DUMMY_REQUEST_bench, /* first benchmark request */
 };
 
+/* signatures of benchmark requests, in the same order as requests */
+static const char bench_signatures[] = "iufsonah";
+
+/* requests handled by display and time spent by dispatching them */
+static uint32_t bench_count[BENCH_REQUESTS_NO];
+static uint64_t bench_busy[BENCH_REQUESTS_NO];
+static int bench_last = -1;
+
 /* when event/request is invoked, save it here */
 static unsigned short events_ackn[EVENTS_NO] = {0};
 static unsigned short requests_ackn[REQUESTS_NO] = {0};
@@ -133,11 +178,85 @@ request_s(struct wl_client *client, struct wl_resource *resource,
 	wl_resource_post_event(resource, DUMMY_REQUEST_s, s);
 }
 
+/* == Benchmark requests, only count them */
+static inline void
+bench_handled(int sig)
+{
+	bench_count[sig]++;
+	bench_last = sig;
+}
+
+static void
+bench_i(struct wl_client *client, struct wl_resource *resource, int32_t i)
+{
+	bench_handled(0);
+}
+
+static void
+bench_u(struct wl_client *client, struct wl_resource *resource, uint32_t u)
+{
+	bench_handled(1);
+}
+
+static void
+bench_f(struct wl_client *client, struct wl_resource *resource,
+	wl_fixed_t f)
+{
+	bench_handled(2);
+}
+
+static void
+bench_s(struct wl_client *client, struct wl_resource *resource,
+	const char *s)
+{
+	bench_handled(3);
+}
+
+static void
+bench_o(struct wl_client *client, struct wl_resource *resource,
+	struct wl_resource *o)
+{
+	bench_handled(4);
+}
+
+static void
+bench_n(struct wl_client *client, struct wl_resource *resource, uint32_t id)
+{
+	struct wl_resource *r;
+
+	r = wl_resource_create(client, &wl_dummy_interface, 1, id);
+	assertf(r, "Failed creating resource");
+	wl_resource_destroy(r);
+
+	bench_handled(5);
+}
+
+static void
+bench_a(struct wl_client *client, struct wl_resource *resource,
+	struct wl_array *a)
+{
+	bench_handled(6);
+}
+
+static void
+bench_h(struct wl_client *client, struct wl_resource *resource, int32_t fd)
+{
+	close(fd);
+	bench_handled(7);
+}
 
 const struct wl_dummy_interface dummy_implementation = {
 	request_empty,
 	request_i,
 	request_s,
+	bench_i,
+	bench_u,
+	bench_f,
+	bench_s,
+	bench_o,
+	bench_n,
+	bench_a,
+	bench_h,
 };
 
 /* == Events */
@@ -312,7 +431,8 @@ proxy_marshal_wrong_opcode(int sock)
 	 * is it correct to let client get SIGSEGV? Isn't better to
 	 * check it and post error so that display can close connection
 	 * etc.? */
-	wl_proxy_marshal((struct wl_proxy *) dummy, REQUESTS_NO + 1);
+	wl_proxy_marshal((struct wl_proxy *) dummy,
+			 REQUESTS_NO + BENCH_REQUESTS_NO + 1);
 
 	wl_display_roundtrip(d);
 	stat = wl_display_get_error(d) != 0;
@@ -394,3 +514,206 @@ TEST(create_setget)
 
 	wit_display_destroy(d);
 }
+
+/*
+ * Dispatch benchmark: client marshals WIT_BENCH_REQUESTS (100000 by
+ * default) requests of each signature, in batches followed by a roundtrip.
+ * Client measures cost of marshalling, display measures cost of reading,
+ * demarshalling and dispatching requests. Results (ns per message) are
+ * appended into benchmarks/marshal-SIG.benchmark and
+ * benchmarks/dispatch-SIG.benchmark
+ */
+#define BENCH_DEFAULT_REQUESTS 100000
+#define BENCH_BATCH 256
+
+/* set before forking client */
+static uint32_t bench_requests;
+
+static uint64_t
+now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench_report(const char *kind, int sig, uint64_t ns, uint32_t count)
+{
+	char name[64];
+	double per_msg = count ? (double) ns / count : 0;
+
+	snprintf(name, sizeof name, "%s-%c", kind, bench_signatures[sig]);
+
+	fprintf(stderr, "%s '%c': %" PRIu32 " requests, %.1f ns/request\n",
+		kind, bench_signatures[sig], count, per_msg);
+
+	assertf(write_benchmark(name, "%" PRIu32 " %.1f", count, per_msg) == 0,
+		"Failed writing benchmark %s", name);
+}
+
+static void
+bench_marshal(struct wl_proxy *dummy, int sig, int fd, struct wl_array *a)
+{
+	struct wl_proxy *p;
+	uint32_t opcode = DUMMY_REQUEST_bench + sig;
+
+	switch (bench_signatures[sig]) {
+	case 'i':
+		wl_proxy_marshal(dummy, opcode, -13);
+		break;
+	case 'u':
+		wl_proxy_marshal(dummy, opcode, 13);
+		break;
+	case 'f':
+		wl_proxy_marshal(dummy, opcode, wl_fixed_from_double(1.3));
+		break;
+	case 's':
+		wl_proxy_marshal(dummy, opcode, "deadbee");
+		break;
+	case 'o':
+		wl_proxy_marshal(dummy, opcode, dummy);
+		break;
+	case 'n':
+		/* includes creating and destroying of the proxy */
+		p = wl_proxy_marshal_constructor(dummy, opcode,
+						 &wl_dummy_interface, NULL);
+		assert(p);
+		wl_proxy_destroy(p);
+		break;
+	case 'a':
+		wl_proxy_marshal(dummy, opcode, a);
+		break;
+	case 'h':
+		wl_proxy_marshal(dummy, opcode, fd);
+		break;
+	default:
+		assertf(0, "Unknown signature");
+	}
+}
+
+static int
+dispatch_bench_main(int sock)
+{
+	struct wl_dummy *dummy = NULL;
+	struct wl_display *d;
+	struct wl_registry *reg;
+	struct wl_array a;
+	uint64_t start, ns;
+	uint32_t n, i, batch;
+	int sig, fd;
+
+	d = wl_display_connect(NULL);
+	assert(d);
+
+	reg = wl_display_get_registry(d);
+	assert(reg);
+
+	wl_registry_add_listener(reg, &registry_listener, &dummy);
+	wl_display_dispatch(d);
+	assertf(dummy, "Proxy has not been created");
+
+	fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	assert(fd >= 0);
+
+	wl_array_init(&a);
+	assert(wl_array_add(&a, 16));
+	memset(a.data, 0xbe, 16);
+
+	for (sig = 0; sig < BENCH_REQUESTS_NO; sig++) {
+		ns = 0;
+
+		for (n = 0; n < bench_requests; n += batch) {
+			batch = bench_requests - n;
+			if (batch > BENCH_BATCH)
+				batch = BENCH_BATCH;
+
+			start = now_nsec();
+			for (i = 0; i < batch; i++)
+				bench_marshal((struct wl_proxy *) dummy, sig,
+					      fd, &a);
+			ns += now_nsec() - start;
+
+			/* don't let requests pile up in the socket */
+			assert(wl_display_roundtrip(d) != -1);
+		}
+
+		bench_report("marshal", sig, ns, bench_requests);
+	}
+
+	assertf(wl_display_get_error(d) == 0, "Error in display occured!");
+
+	wl_array_release(&a);
+	close(fd);
+	wl_proxy_destroy((struct wl_proxy *) dummy);
+	wl_registry_destroy(reg);
+	wl_display_disconnect(d);
+
+	return EXIT_SUCCESS;
+}
+
+/* what wit_display_run() does, but measure how long it takes to dispatch
+ * benchmark requests (waiting for them is not measured) */
+static void
+run_bench_loop(struct wit_display *d)
+{
+	struct pollfd pfd;
+	uint64_t start;
+
+	send_message(d->client_sock[1], CAN_CONTINUE, 1);
+
+	pfd.fd = wl_event_loop_get_fd(d->loop);
+	pfd.events = POLLIN;
+
+	/* client is a zombie until SIGCHLD handler waits for it */
+	while (kill(d->client_pid, 0) == 0) {
+		if (poll(&pfd, 1, -1) < 0) {
+			assertf(errno == EINTR, "poll failed: %m");
+			continue;
+		}
+
+		bench_last = -1;
+
+		start = now_nsec();
+		wl_event_loop_dispatch(d->loop, 0);
+		wl_display_flush_clients(d->display);
+
+		/* client sends requests of one signature at a time */
+		if (bench_last >= 0)
+			bench_busy[bench_last] += now_nsec() - start;
+	}
+}
+
+BENCHMARK_TEST(dispatch_bench_tst)
+{
+	struct wit_display *d;
+	struct wl_global *dummy_global;
+	const char *env;
+	int sig;
+
+	env = getenv("WIT_BENCH_REQUESTS");
+	bench_requests = env ? strtoul(env, NULL, 10) : BENCH_DEFAULT_REQUESTS;
+	assertf(bench_requests > 0, "Wrong WIT_BENCH_REQUESTS");
+
+	d = wit_display_create(NULL);
+	wit_display_create_client(d, dispatch_bench_main);
+
+	dummy_global = wl_global_create(d->display, &wl_dummy_interface,
+					1, d, dummy_bind);
+	assert(dummy_global);
+
+	run_bench_loop(d);
+
+	for (sig = 0; sig < BENCH_REQUESTS_NO; sig++) {
+		assertf(bench_count[sig] == bench_requests,
+			"Handled %" PRIu32 " requests '%c'",
+			bench_count[sig], bench_signatures[sig]);
+		bench_report("dispatch", sig, bench_busy[sig],
+			     bench_count[sig]);
+	}
+
+	wl_global_destroy(dummy_global);
+	wit_display_destroy(d);
+}
@@ -21,7 +21,11 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <wayland-client.h>
 #include <wayland-server.h>
 
@@ -233,3 +237,156 @@ TEST(global_tst)
 	wl_global_destroy(g);
 	wit_display_destroy(d);
 }
+
+/*
+ * Registry benchmark: how long it takes to enumerate globals, to bind
+ * them with roundtrip after each global (wit_client_populate()) and to
+ * bind them all at once (wit_client_populate_batch()), when display has
+ * N synthetic globals. Ns can be set by WIT_BENCH_GLOBALS (comma
+ * separated list). Results are appended into
+ * benchmarks/registry-MODE-N.benchmark as "globals nanoseconds", one file
+ * per N (like roundtrip-LOAD), so that every N is a series of its own
+ *
+ * NOTE: roundtrip in registry listener dispatches the following globals,
+ * so wit_client_populate() recurses once per global. Keep that in mind
+ * when trying really large numbers.
+ */
+#define BENCH_DEFAULT_GLOBALS "10,100,1000"
+
+enum bench_mode {
+	BENCH_ENUMERATE = 0,
+	BENCH_BIND,
+	BENCH_BATCH,
+	BENCH_MODES_NO
+};
+
+static const char *bench_mode_names[] = {
+	"enumerate", "bind", "batch"
+};
+
+/* set before forking client */
+static uint32_t bench_globals;
+static enum bench_mode bench_mode;
+
+static uint32_t bench_seen;
+
+static uint64_t
+now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+bench_handle_global(void *data, struct wl_registry *registry,
+		    uint32_t id, const char *interface, uint32_t version)
+{
+	if (strcmp(interface, "wit_synthetic") == 0)
+		bench_seen++;
+}
+
+static const struct wl_registry_listener bench_registry_listener = {
+	bench_handle_global,
+	NULL
+};
+
+static uint64_t
+bench_enumerate(int sock)
+{
+	struct wit_client c;
+	struct wl_registry *registry;
+	uint64_t start, ns;
+
+	wit_client_init(&c, sock);
+
+	start = now_nsec();
+	registry = wl_display_get_registry(c.display);
+	wl_registry_add_listener(registry, &bench_registry_listener, NULL);
+	wl_display_roundtrip(c.display);
+	ns = now_nsec() - start;
+
+	assertf(bench_seen == bench_globals, "Got %" PRIu32 " globals",
+		bench_seen);
+
+	wl_registry_destroy(registry);
+	wl_display_disconnect(c.display);
+	close(sock);
+
+	return ns;
+}
+
+static uint64_t
+bench_bind(int sock, int batch)
+{
+	struct wit_client *c;
+	uint64_t start, ns;
+
+	start = now_nsec();
+	c = batch ? wit_client_populate_batch(sock)
+		  : wit_client_populate(sock);
+	ns = now_nsec() - start;
+
+	assertf(c->synthetic.size / sizeof(struct wl_proxy *) == bench_globals,
+		"Bound %zu globals",
+		c->synthetic.size / sizeof(struct wl_proxy *));
+	assert(c->seat.proxy && c->compositor.proxy);
+
+	wit_client_free(c);
+
+	return ns;
+}
+
+static int
+registry_bench_main(int sock)
+{
+	uint64_t ns;
+	char name[64];
+
+	if (bench_mode == BENCH_ENUMERATE)
+		ns = bench_enumerate(sock);
+	else
+		ns = bench_bind(sock, bench_mode == BENCH_BATCH);
+
+	fprintf(stderr, "%s %" PRIu32 " globals: %.1f us\n",
+		bench_mode_names[bench_mode], bench_globals, ns / 1000.0);
+
+	snprintf(name, sizeof name, "registry-%s-%" PRIu32,
+		 bench_mode_names[bench_mode], bench_globals);
+	assertf(write_benchmark(name, "%" PRIu32 " %" PRIu64,
+				bench_globals, ns) == 0,
+		"Failed writing benchmark %s", name);
+
+	return EXIT_SUCCESS;
+}
+
+BENCHMARK_TEST(registry_bench_tst)
+{
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR, CONF_ALL, 0};
+	struct wit_display *d;
+	const char *env;
+	char *counts, *tok, *saveptr = NULL;
+
+	env = getenv("WIT_BENCH_GLOBALS");
+	counts = strdup(env ? env : BENCH_DEFAULT_GLOBALS);
+	assert(counts);
+
+	for (tok = strtok_r(counts, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		bench_globals = strtoul(tok, NULL, 10);
+		conf.synthetic.count = bench_globals;
+
+		/* each mode needs its own connection */
+		for (bench_mode = 0; bench_mode < BENCH_MODES_NO;
+		     bench_mode++) {
+			d = wit_display_create(&conf);
+			wit_display_create_client(d, registry_bench_main);
+			wit_display_run(d);
+			wit_display_destroy(d);
+		}
+	}
+
+	free(counts);
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <wayland-client.h>
+#include <wayland-server.h>
+
+#include "test-runner.h"
+#include "wit.h"
+
+#define WIDTH	64
+#define HEIGHT	48
+#define STRIDE	(WIDTH * 4 + 16) /* padding is not checksummed */
+
+TEST(crc32c_tst)
+{
+	uint32_t crc;
+
+	/* check value of CRC32C */
+	assert(wit_crc32c(0, "123456789", 9) == 0xe3069283);
+	assert(wit_crc32c(0, NULL, 0) == 0);
+
+	/* checksum computed by parts must be the same */
+	crc = wit_crc32c(0, "1234", 4);
+	assert(wit_crc32c(crc, "56789", 5) == 0xe3069283);
+}
+
+TEST(shm_checksum_padding_tst)
+{
+	uint32_t c1, c2;
+	char *pixels = calloc(HEIGHT, STRIDE);
+	assert(pixels && "Out of memory");
+
+	c1 = wit_shm_checksum(pixels, WIDTH, HEIGHT, STRIDE,
+			      WL_SHM_FORMAT_XRGB8888);
+
+	/* garbage in padding */
+	memset(pixels + WIDTH * 4, 0xff, 16);
+	c2 = wit_shm_checksum(pixels, WIDTH, HEIGHT, STRIDE,
+			      WL_SHM_FORMAT_XRGB8888);
+	assertf(c1 == c2, "Padding changed checksum");
+
+	/* visible pixel */
+	pixels[0] = 1;
+	c2 = wit_shm_checksum(pixels, WIDTH, HEIGHT, STRIDE,
+			      WL_SHM_FORMAT_XRGB8888);
+	assertf(c1 != c2, "Checksum didn't change");
+
+	free(pixels);
+}
+
+#define BENCH_WIDTH	1024
+#define BENCH_HEIGHT	768
+
+BENCHMARK(shm_checksum_bench)
+{
+	uint64_t i;
+	uint32_t crc = 0;
+	char *pixels = malloc(BENCH_WIDTH * BENCH_HEIGHT * 4);
+	assert(pixels && "Out of memory");
+
+	memset(pixels, 0x5a, BENCH_WIDTH * BENCH_HEIGHT * 4);
+
+	benchmark_start(b);
+	for (i = 0; i < b->iterations; ++i)
+		crc ^= wit_shm_checksum(pixels, BENCH_WIDTH, BENCH_HEIGHT,
+					BENCH_WIDTH * 4,
+					WL_SHM_FORMAT_XRGB8888);
+	benchmark_stop(b);
+
+	/* use the result, so that the loop is not optimized out */
+	assert(b->iterations % 2 == 1 || crc == 0);
+
+	benchmark_set_bytes(b, BENCH_WIDTH * BENCH_HEIGHT * 4);
+	free(pixels);
+}
+
+static void
+fill_buffer(uint32_t *pixels, uint32_t color)
+{
+	int x, y;
+
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++)
+			pixels[y * (STRIDE / 4) + x] = color ^ (x << 8) ^ y;
+}
+
+static int
+commit_checksum_main(int sock)
+{
+	int fd;
+	uint32_t *pixels;
+	uint32_t checksums[2];
+	struct wl_shm_pool *pool;
+	struct wl_buffer *buffer;
+	struct wl_surface *surface;
+	struct wit_client *c = wit_client_populate(sock);
+
+	surface = wl_compositor_create_surface(
+			(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	fd = create_anonymous_file(STRIDE * HEIGHT);
+	assertf(fd >= 0, "Failed creating file for shm pool");
+
+	pixels = mmap(NULL, STRIDE * HEIGHT, PROT_READ | PROT_WRITE,
+		      MAP_SHARED, fd, 0);
+	assert(pixels != MAP_FAILED);
+
+	pool = wl_shm_create_pool((struct wl_shm *) c->shm.proxy,
+				  fd, STRIDE * HEIGHT);
+	buffer = wl_shm_pool_create_buffer(pool, 0, WIDTH, HEIGHT, STRIDE,
+					   WL_SHM_FORMAT_XRGB8888);
+	assert(buffer);
+
+	/* first frame */
+	fill_buffer(pixels, 0xff0000);
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_commit(surface);
+	wl_display_roundtrip(c->display);
+
+	checksums[0] = wit_shm_checksum(pixels, WIDTH, HEIGHT, STRIDE,
+					WL_SHM_FORMAT_XRGB8888);
+
+	/* second frame, display released the buffer, so we can reuse it */
+	fill_buffer(pixels, 0x00ff00);
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_commit(surface);
+
+	/* commit without attach doesn't bring new contents */
+	wl_surface_commit(surface);
+	wl_display_roundtrip(c->display);
+
+	checksums[1] = wit_shm_checksum(pixels, WIDTH, HEIGHT, STRIDE,
+					WL_SHM_FORMAT_XRGB8888);
+	assert(checksums[0] != checksums[1]);
+
+	wit_client_send_data(c, checksums, sizeof checksums);
+
+	/* let display check the surface before it's destroyed */
+	wit_client_barrier(c);
+
+	wl_buffer_destroy(buffer);
+	wl_shm_pool_destroy(pool);
+	wl_surface_destroy(surface);
+	munmap(pixels, STRIDE * HEIGHT);
+	close(fd);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(commit_checksum_tst)
+{
+	struct wit_surface *s;
+	uint32_t *checksums;
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR | CONF_SHM,
+				  CONF_ALL, 0};
+	struct wit_display *d
+		= wit_display_create_and_run(&conf, commit_checksum_main);
+
+	/* returns when client waits in barrier */
+	wit_display_recieve_data(d);
+	checksums = d->data;
+
+	assert(d->resources.surface);
+	s = wit_display_get_surface(d, wl_resource_get_id(d->resources.surface));
+	assert(s);
+
+	assertf(s->checksums.size == 2 * sizeof(uint32_t),
+		"Expected 2 checksums, have %lu",
+		s->checksums.size / sizeof(uint32_t));
+	assertf(((uint32_t *) s->checksums.data)[0] == checksums[0],
+		"Checksums of the first frame differ");
+	assertf(wit_surface_get_checksum(s) == checksums[1],
+		"Checksums of the second frame differ");
+
+	wit_display_barrier(d);
+	wit_display_destroy(d);
+}
+
+TEST(pixels_diff_tst)
+{
+	int i;
+	uint32_t a[37], b[37];
+
+	for (i = 0; i < 37; i++)
+		a[i] = b[i] = 0x80808080 + i;
+
+	assert(wit_pixels_diff(a, b, 37, 0, 0) == 0);
+
+	/* small differences in the first and the last pixel
+	 * (the last one is not a multiple of 4) */
+	b[0] += 0x00000002;
+	b[36] -= 0x00020000;
+	assert(wit_pixels_diff(a, b, 37, 0, 0) == 2);
+	assert(wit_pixels_diff(a, b, 37, 1, 0) == 2);
+	assert(wit_pixels_diff(a, b, 37, 2, 0) == 0);
+
+	/* big difference in alpha only */
+	b[17] += 0x40000000;
+	assert(wit_pixels_diff(a, b, 37, 2, 0) == 1);
+	assert(wit_pixels_diff(a, b, 37, 2, 1) == 0);
+}
+
+static void
+remove_dir(const char *path)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char file[PATH_MAX];
+
+	dir = opendir(path);
+	assert(dir);
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		snprintf(file, sizeof file, "%s/%s", path, ent->d_name);
+		unlink(file);
+	}
+
+	closedir(dir);
+	rmdir(path);
+}
+
+static int
+count_files(const char *path)
+{
+	DIR *dir;
+	struct dirent *ent;
+	int count = 0;
+
+	dir = opendir(path);
+	assert(dir);
+
+	while ((ent = readdir(dir)))
+		if (ent->d_name[0] != '.')
+			count++;
+
+	closedir(dir);
+	return count;
+}
+
+static int
+snapshot_store_main(int sock)
+{
+	int fd;
+	uint32_t *pixels;
+	struct wl_shm_pool *pool;
+	struct wl_buffer *buffer;
+	struct wl_surface *surface;
+	struct wit_client *c = wit_client_populate(sock);
+
+	surface = wl_compositor_create_surface(
+			(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	fd = create_anonymous_file(STRIDE * HEIGHT);
+	assertf(fd >= 0, "Failed creating file for shm pool");
+
+	pixels = mmap(NULL, STRIDE * HEIGHT, PROT_READ | PROT_WRITE,
+		      MAP_SHARED, fd, 0);
+	assert(pixels != MAP_FAILED);
+
+	pool = wl_shm_create_pool((struct wl_shm *) c->shm.proxy,
+				  fd, STRIDE * HEIGHT);
+	buffer = wl_shm_pool_create_buffer(pool, 0, WIDTH, HEIGHT, STRIDE,
+					   WL_SHM_FORMAT_XRGB8888);
+	assert(buffer);
+
+	/* the same contents twice, it should be stored only once */
+	fill_buffer(pixels, 0xff0000);
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_commit(surface);
+	wl_display_roundtrip(c->display);
+
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_commit(surface);
+	wl_display_roundtrip(c->display);
+
+	fill_buffer(pixels, 0x0000ff);
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_commit(surface);
+	wl_display_roundtrip(c->display);
+
+	/* let display check the store */
+	wit_client_barrier(c);
+
+	wl_buffer_destroy(buffer);
+	wl_shm_pool_destroy(pool);
+	wl_surface_destroy(surface);
+	munmap(pixels, STRIDE * HEIGHT);
+	close(fd);
+
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+TEST(snapshot_store_tst)
+{
+	char dir[] = "/tmp/wit-snapshots-XXXXXX";
+	char golden[PATH_MAX];
+	struct wit_surface *s;
+	uint32_t *pixels;
+	int i;
+	struct wit_config conf = {CONF_SEAT | CONF_COMPOSITOR | CONF_SHM,
+				  CONF_ALL, 0};
+	struct wit_display *d = wit_display_create(&conf);
+
+	assert(mkdtemp(dir));
+	wit_display_set_snapshot_dir(d, dir);
+
+	wit_display_create_client(d, snapshot_store_main);
+	wit_display_run(d);
+
+	s = wit_display_get_surface(d, wl_resource_get_id(d->resources.surface));
+	assert(s);
+
+	assertf(s->checksums.size == 3 * sizeof(uint32_t),
+		"Expected 3 commits, have %lu",
+		s->checksums.size / sizeof(uint32_t));
+	assertf(count_files(dir) == 2,
+		"Expected 2 snapshots in store, have %d", count_files(dir));
+
+	/* create golden image of the last frame */
+	pixels = calloc(HEIGHT, STRIDE);
+	assert(pixels && "Out of memory");
+	fill_buffer(pixels, 0x0000ff);
+
+	snprintf(golden, sizeof golden, "%s.golden", dir);
+	assert(wit_snapshot_save(golden, pixels, WIDTH, HEIGHT, STRIDE,
+				 WL_SHM_FORMAT_XRGB8888) == 0);
+	assert(wit_display_compare_golden(d, s, golden, 0) == 0);
+
+	/* small differences and garbage in alpha */
+	for (i = 0; i < 10; i++) {
+		pixels[i * (STRIDE / 4) + i] ^= 0x000101;
+		pixels[i] |= 0xff000000;
+	}
+
+	assert(wit_snapshot_save(golden, pixels, WIDTH, HEIGHT, STRIDE,
+				 WL_SHM_FORMAT_XRGB8888) == 0);
+	assert(wit_display_compare_golden(d, s, golden, 0) == 10);
+	assert(wit_display_compare_golden(d, s, golden, 1) == 0);
+
+	/* different size */
+	assert(wit_snapshot_save(golden, pixels, WIDTH / 2, HEIGHT, STRIDE,
+				 WL_SHM_FORMAT_XRGB8888) == 0);
+	assert(wit_display_compare_golden(d, s, golden, 255)
+		== WIT_SNAPSHOT_INCOMPARABLE);
+
+	unlink(golden);
+	remove_dir(dir);
+	free(pixels);
+
+	wit_display_barrier(d);
+	wit_display_destroy(d);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <wayland-client.h>
+#include <wayland-server.h>
+
+#include "test-runner.h"
+#include "wit.h"
+
+struct touch_state {
+	int down, up, motion, frame, cancel;
+	uint32_t ids;		/* bitmap of fingers that are down */
+	int in_frame;		/* events in current frame */
+	wl_fixed_t x, y;	/* last position of finger 0 */
+};
+
+static void
+touch_handle_down(void *data, struct wl_touch *touch, uint32_t serial,
+		  uint32_t time, struct wl_surface *surface, int32_t id,
+		  wl_fixed_t x, wl_fixed_t y)
+{
+	struct touch_state *ts = ((struct wit_client *) data)->data;
+
+	assert(surface);
+	assertf(!(ts->ids & (1 << id)), "Finger %d is already down", id);
+
+	ts->ids |= 1 << id;
+	ts->down++;
+	ts->in_frame++;
+}
+
+static void
+touch_handle_up(void *data, struct wl_touch *touch, uint32_t serial,
+		uint32_t time, int32_t id)
+{
+	struct touch_state *ts = ((struct wit_client *) data)->data;
+
+	assertf(ts->ids & (1 << id), "Finger %d is not down", id);
+
+	ts->ids &= ~(1 << id);
+	ts->up++;
+	ts->in_frame++;
+}
+
+static void
+touch_handle_motion(void *data, struct wl_touch *touch, uint32_t time,
+		    int32_t id, wl_fixed_t x, wl_fixed_t y)
+{
+	struct touch_state *ts = ((struct wit_client *) data)->data;
+
+	assertf(ts->ids & (1 << id), "Finger %d is not down", id);
+
+	if (id == 0) {
+		ts->x = x;
+		ts->y = y;
+	}
+
+	ts->motion++;
+	ts->in_frame++;
+}
+
+static void
+touch_handle_frame(void *data, struct wl_touch *touch)
+{
+	struct touch_state *ts = ((struct wit_client *) data)->data;
+
+	/* all fingers are in every frame */
+	assertf(ts->in_frame == __builtin_popcount(ts->ids)
+		|| (ts->ids == 0 && ts->in_frame > 0),
+		"Frame with %d events", ts->in_frame);
+
+	ts->in_frame = 0;
+	ts->frame++;
+}
+
+static void
+touch_handle_cancel(void *data, struct wl_touch *touch)
+{
+	struct touch_state *ts = ((struct wit_client *) data)->data;
+
+	ts->ids = 0;
+	ts->cancel++;
+}
+
+static const struct wl_touch_listener touch_listener = {
+	touch_handle_down,
+	touch_handle_up,
+	touch_handle_motion,
+	touch_handle_frame,
+	touch_handle_cancel
+};
+
+/* forked client gets copy of this */
+static struct wit_touch_gesture gesture;
+
+static int
+touch_gesture_main(int sock)
+{
+	struct touch_state ts;
+	struct wit_client *c = wit_client_populate(sock);
+	struct wl_surface *surface
+				= wl_compositor_create_surface(
+					(struct wl_compositor *) c->compositor.proxy);
+	assert(surface);
+
+	memset(&ts, 0, sizeof ts);
+	c->data = &ts;
+	wit_client_add_listener(c, "wl_touch", &touch_listener);
+
+	/* make sure display has created touch resource */
+	wl_display_roundtrip(c->display);
+	wl_display_roundtrip(c->display);
+	wit_client_barrier(c);
+
+	wit_client_ask_for_events(c, 0);
+	wl_display_roundtrip(c->display);
+
+	assert(ts.down == (int) gesture.fingers);
+	assertf(ts.motion == (int) (gesture.fingers * gesture.samples),
+		"Got %d motion events", ts.motion);
+	assert(ts.ids == 0);
+
+	if (gesture.cancel) {
+		assert(ts.cancel == 1 && ts.up == 0);
+		assert(ts.frame == (int) gesture.samples + 1);
+	} else {
+		assert(ts.cancel == 0 && ts.up == (int) gesture.fingers);
+		assert(ts.frame == (int) gesture.samples + 2);
+	}
+
+	/* finger 0 starts at angle 0 */
+	assert(ts.x == wl_fixed_from_double(gesture.center.x + gesture.radius
+					    + gesture.distance));
+	assert(ts.y == wl_fixed_from_double(gesture.center.y));
+
+	wl_surface_destroy(surface);
+	wit_client_free(c);
+	return EXIT_SUCCESS;
+}
+
+static void
+run_gesture(void)
+{
+	struct wit_display *d = wit_display_create(NULL);
+
+	wit_display_create_client(d, touch_gesture_main);
+	wit_display_run(d);
+
+	/* wait for client to create surface */
+	wit_display_barrier(d);
+
+	wit_display_add_generator(d, wit_touch_generator_create(&gesture));
+	wit_display_emit_events(d);
+
+	assertf(d->generator == NULL, "Generator should be exhausted");
+
+	wit_display_destroy(d);
+}
+
+TEST(touch_swipe_tst)
+{
+	memset(&gesture, 0, sizeof gesture);
+	gesture.type = WIT_GESTURE_SWIPE;
+	gesture.fingers = 10;
+	gesture.rate = 240;
+	gesture.samples = 24;
+	gesture.center.x = 200;
+	gesture.center.y = 100;
+	gesture.radius = 50;
+	gesture.distance = 100;
+
+	run_gesture();
+}
+
+TEST(touch_cancel_tst)
+{
+	memset(&gesture, 0, sizeof gesture);
+	gesture.type = WIT_GESTURE_PINCH;
+	gesture.fingers = 2;
+	gesture.samples = 12;
+	gesture.center.x = 100;
+	gesture.center.y = 100;
+	gesture.radius = 10;
+	gesture.distance = 40;
+	gesture.cancel = 1;
+
+	run_gesture();
+}
+
+TEST(touch_rotate_point_tst)
+{
+	struct wit_point p;
+
+	memset(&gesture, 0, sizeof gesture);
+	gesture.type = WIT_GESTURE_ROTATE;
+	gesture.fingers = 4;
+	gesture.samples = 2;
+	gesture.radius = 10;
+	gesture.distance = M_PI;
+
+	/* finger 1 starts at quarter of circle */
+	p = wit_touch_gesture_point(&gesture, 1, 0);
+	assert(p.x > -0.001 && p.x < 0.001 && p.y > 9.999 && p.y < 10.001);
+
+	/* half way it's rotated by M_PI / 2 */
+	p = wit_touch_gesture_point(&gesture, 1, 1);
+	assert(p.x > -10.001 && p.x < -9.999 && p.y > -0.001 && p.y < 0.001);
+}
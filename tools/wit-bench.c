@@ -0,0 +1,896 @@
+/*
+ * Copyright © 2013 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+
+/*
+ * wit-bench: tool for manipulation with benchmarks outcomes
+ *
+ * Histories in benchmarks/NAME.benchmark grow by one line per run. The tool
+ * compacts them into binary store indexed by commits, shows trends of
+ * benchmarks and looks for statistically significant regressions (Welch's
+ * t-test) between two commits or between the last commit and a rolling
+ * baseline of previous commits. When a regression is found, it exits with
+ * 1, so that it can be used to gate CI. See usage() and
+ * test/benchmarks/README.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <err.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define EXIT_REGRESSION 1
+#define EXIT_ERROR 2
+
+#define STORE_MAGIC "WITB"
+#define STORE_VERSION 1
+
+#define COMMIT_LEN 40
+#define NAME_LEN 128
+#define MAX_FIELDS 8
+
+/*
+ * Store is native-endian file:
+ *
+ *	struct store_header
+ *	struct store_commit	commits[commits_no]	(in order of first run)
+ *	struct store_series	series[series_no]
+ *	struct store_record	records[records_no]	(sorted by commit)
+ *
+ * Records of one commit are contiguous, commit knows where they are.
+ */
+struct store_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t commits_no;
+	uint32_t series_no;
+	uint64_t records_no;
+};
+
+struct store_commit {
+	char id[COMMIT_LEN + 1];
+	char pad[7];
+	uint64_t timestamp;	/* of the first record */
+	uint64_t first_record;
+	uint64_t records_no;
+};
+
+struct store_series {
+	char name[NAME_LEN];	/* file name without .benchmark */
+};
+
+struct store_record {
+	uint32_t commit;
+	uint32_t series;
+	uint64_t timestamp;
+	uint32_t fields_no;
+	uint32_t pad;
+	double fields[MAX_FIELDS];	/* NAN for unavailable ("-") */
+};
+
+struct store {
+	struct store_commit *commits;
+	uint32_t commits_no;
+
+	struct store_series *series;
+	uint32_t series_no;
+
+	struct store_record *records;
+	uint64_t records_no;
+	uint64_t records_size;
+};
+
+/* which field of record is compared and which direction is better.
+ * Fields are counted from 1 after the commit */
+struct metric {
+	const char *pattern;	/* fnmatch pattern of series name */
+	int field;		/* 0 = seconds + nanoseconds in fields 1, 2 */
+	int higher_better;
+	const char *unit;
+};
+
+static const struct metric metrics[] = {
+	{ "*-stats", 3, 0, "ns (median)" },
+	{ "*-throughput", 3, 0, "ns/iteration" },
+	{ "*-perf", 3, 0, "instructions" },
+	{ "roundtrip-*", 2, 0, "ns (p50)" },
+	{ "sync-*", 2, 0, "ns (p50)" },
+	{ "marshal-*", 2, 0, "ns/request" },
+	{ "dispatch-*", 2, 0, "ns/request" },
+	{ "registry-*", 2, 0, "ns" },
+	{ "objects-*", 3, 1, "objects/s (last tenth)" },
+	/* duration of test */
+	{ "*", 0, 0, "s" }
+};
+
+/* options of comparing */
+static int opt_field = -1;
+static int opt_higher_better;
+static double opt_alpha = 0.01;
+static double opt_ratio = 0.02;
+
+static void
+usage(const char *name, int status)
+{
+	fprintf(status == EXIT_SUCCESS ? stdout : stderr,
+		"Usage: %s compact [-t] STORE FILE...\n"
+		"       %s trend [-n N] [-f FIELD] STORE [NAME...]\n"
+		"       %s compare [OPTIONS] STORE BASE NEW [NAME...]\n"
+		"       %s check [-w N] [OPTIONS] STORE [NAME...]\n\n"
+		"  compact   add records of FILEs (benchmarks/NAME.benchmark)\n"
+		"            into STORE, -t truncates FILEs afterwards\n"
+		"  trend     show means of last N (10) commits and trend\n"
+		"  compare   compare commit NEW with commit BASE (prefixes\n"
+		"            of commits are enough)\n"
+		"  check     compare the last commit with N (5) previous ones\n\n"
+		"NAMEs are patterns of benchmarks (e.g. 'roundtrip-*').\n\n"
+		"Options:\n"
+		"  -a ALPHA  significance level (default 0.01)\n"
+		"  -r RATIO  ignore changes smaller than RATIO of the base\n"
+		"            (default 0.02)\n"
+		"  -f FIELD  compare FIELD of records (from 1) instead of\n"
+		"            the default one for the benchmark\n"
+		"  -H        with -f, higher values are better\n\n"
+		"Exit status is 1 when a regression was found, 2 on error.\n",
+		name, name, name, name);
+
+	exit(status);
+}
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (ptr == NULL && size > 0)
+		errx(EXIT_ERROR, "Out of memory");
+
+	return ptr;
+}
+
+static void
+store_free(struct store *s)
+{
+	free(s->commits);
+	free(s->series);
+	free(s->records);
+	memset(s, 0, sizeof *s);
+}
+
+/* load store from file, missing file is empty store.
+ * Returns 0 on success, -1 on error */
+static int
+store_load(struct store *s, const char *path)
+{
+	struct store_header h;
+	FILE *f;
+
+	memset(s, 0, sizeof *s);
+
+	f = fopen(path, "r");
+	if (f == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	if (fread(&h, sizeof h, 1, f) != 1
+	    || memcmp(h.magic, STORE_MAGIC, 4) != 0
+	    || h.version != STORE_VERSION) {
+		warnx("%s is not a benchmark store", path);
+		fclose(f);
+		return -1;
+	}
+
+	s->commits = xrealloc(NULL, h.commits_no * sizeof *s->commits);
+	s->series = xrealloc(NULL, h.series_no * sizeof *s->series);
+	s->records = xrealloc(NULL, h.records_no * sizeof *s->records);
+	s->commits_no = h.commits_no;
+	s->series_no = h.series_no;
+	s->records_no = s->records_size = h.records_no;
+
+	if (fread(s->commits, sizeof *s->commits, s->commits_no, f)
+		!= s->commits_no
+	    || fread(s->series, sizeof *s->series, s->series_no, f)
+		!= s->series_no
+	    || fread(s->records, sizeof *s->records, s->records_no, f)
+		!= s->records_no) {
+		warnx("%s is truncated", path);
+		fclose(f);
+		store_free(s);
+		return -1;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/* write store into temporary file and rename it, so that the store
+ * is never left half-written */
+static int
+store_save(const struct store *s, const char *path)
+{
+	struct store_header h;
+	char *tmp;
+	FILE *f;
+	int ok;
+
+	memset(&h, 0, sizeof h);
+	memcpy(h.magic, STORE_MAGIC, 4);
+	h.version = STORE_VERSION;
+	h.commits_no = s->commits_no;
+	h.series_no = s->series_no;
+	h.records_no = s->records_no;
+
+	if (asprintf(&tmp, "%s.tmp", path) < 0)
+		errx(EXIT_ERROR, "Out of memory");
+
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	ok = fwrite(&h, sizeof h, 1, f) == 1
+	     && fwrite(s->commits, sizeof *s->commits, s->commits_no, f)
+		== s->commits_no
+	     && fwrite(s->series, sizeof *s->series, s->series_no, f)
+		== s->series_no
+	     && fwrite(s->records, sizeof *s->records, s->records_no, f)
+		== s->records_no;
+
+	if (fclose(f) != 0)
+		ok = 0;
+
+	if (ok && rename(tmp, path) == 0) {
+		free(tmp);
+		return 0;
+	}
+
+	unlink(tmp);
+	free(tmp);
+	return -1;
+}
+
+static uint32_t
+store_get_commit(struct store *s, const char *id, uint64_t timestamp)
+{
+	uint32_t i;
+
+	for (i = 0; i < s->commits_no; ++i) {
+		if (strcmp(s->commits[i].id, id) == 0) {
+			if (timestamp < s->commits[i].timestamp)
+				s->commits[i].timestamp = timestamp;
+			return i;
+		}
+	}
+
+	s->commits = xrealloc(s->commits,
+			      (s->commits_no + 1) * sizeof *s->commits);
+	memset(&s->commits[i], 0, sizeof s->commits[i]);
+	snprintf(s->commits[i].id, sizeof s->commits[i].id, "%s", id);
+	s->commits[i].timestamp = timestamp;
+
+	return s->commits_no++;
+}
+
+static uint32_t
+store_get_series(struct store *s, const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < s->series_no; ++i)
+		if (strcmp(s->series[i].name, name) == 0)
+			return i;
+
+	s->series = xrealloc(s->series,
+			     (s->series_no + 1) * sizeof *s->series);
+	memset(&s->series[i], 0, sizeof s->series[i]);
+	snprintf(s->series[i].name, NAME_LEN, "%s", name);
+
+	return s->series_no++;
+}
+
+static struct store_record *
+store_add_record(struct store *s)
+{
+	if (s->records_no == s->records_size) {
+		s->records_size = s->records_size ? s->records_size * 2 : 256;
+		s->records = xrealloc(s->records,
+				      s->records_size * sizeof *s->records);
+	}
+
+	memset(&s->records[s->records_no], 0, sizeof *s->records);
+	return &s->records[s->records_no++];
+}
+
+/* parse history of one benchmark, returns number of added records
+ * or -1 on error */
+static int
+store_add_history(struct store *s, const char *path)
+{
+	char name[NAME_LEN], commit[COMMIT_LEN + 1];
+	char *line = NULL, *p, *end, *copy, *suffix;
+	struct store_record *r;
+	unsigned long long timestamp;
+	size_t size = 0;
+	uint32_t series;
+	int added = 0, lineno = 0, n;
+	FILE *f;
+
+	copy = strdup(path);
+	if (copy == NULL)
+		errx(EXIT_ERROR, "Out of memory");
+	snprintf(name, sizeof name, "%s", basename(copy));
+	free(copy);
+
+	suffix = strstr(name, ".benchmark");
+	if (suffix)
+		*suffix = '\0';
+
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -1;
+
+	series = store_get_series(s, name);
+
+	while (getline(&line, &size, f) != -1) {
+		++lineno;
+
+		if (sscanf(line, "%llu %40s %n", &timestamp, commit, &n) != 2) {
+			warnx("%s:%d: malformed record", path, lineno);
+			continue;
+		}
+
+		r = store_add_record(s);
+		r->series = series;
+		r->timestamp = timestamp;
+		r->commit = store_get_commit(s, commit, timestamp);
+
+		for (p = line + n; r->fields_no < MAX_FIELDS; p = end) {
+			while (*p == ' ' || *p == '\t')
+				++p;
+
+			if (*p == '-' && (p[1] == '\0' || p[1] == ' '
+					  || p[1] == '\n')) {
+				r->fields[r->fields_no++] = NAN;
+				end = p + 1;
+				continue;
+			}
+
+			r->fields[r->fields_no] = strtod(p, &end);
+			if (end == p)
+				break;
+
+			++r->fields_no;
+		}
+
+		++added;
+	}
+
+	free(line);
+	fclose(f);
+
+	return added;
+}
+
+static int
+compare_records(const void *a, const void *b)
+{
+	const struct store_record *x = a, *y = b;
+
+	if (x->commit != y->commit)
+		return x->commit < y->commit ? -1 : 1;
+	if (x->series != y->series)
+		return x->series < y->series ? -1 : 1;
+	if (x->timestamp != y->timestamp)
+		return x->timestamp < y->timestamp ? -1 : 1;
+
+	return memcmp(x->fields, y->fields, sizeof x->fields);
+}
+
+/* commit timestamps of the store given to qsort */
+static const struct store_commit *sort_commits;
+
+static int
+compare_commit_indices(const void *a, const void *b)
+{
+	const struct store_commit *x = &sort_commits[*(const uint32_t *) a];
+	const struct store_commit *y = &sort_commits[*(const uint32_t *) b];
+
+	if (x->timestamp != y->timestamp)
+		return x->timestamp < y->timestamp ? -1 : 1;
+
+	return strcmp(x->id, y->id);
+}
+
+/* order commits by their first run, sort records by commits, drop
+ * duplicate records (the same history compacted twice) and index
+ * records of commits */
+static void
+store_reindex(struct store *s)
+{
+	struct store_commit *commits;
+	uint32_t *order, *rank, i;
+	uint64_t r, w;
+
+	order = xrealloc(NULL, s->commits_no * sizeof *order);
+	rank = xrealloc(NULL, s->commits_no * sizeof *rank);
+	for (i = 0; i < s->commits_no; ++i)
+		order[i] = i;
+
+	sort_commits = s->commits;
+	qsort(order, s->commits_no, sizeof *order, compare_commit_indices);
+
+	commits = xrealloc(NULL, s->commits_no * sizeof *commits);
+	for (i = 0; i < s->commits_no; ++i) {
+		commits[i] = s->commits[order[i]];
+		rank[order[i]] = i;
+	}
+
+	free(s->commits);
+	s->commits = commits;
+
+	for (r = 0; r < s->records_no; ++r)
+		s->records[r].commit = rank[s->records[r].commit];
+
+	free(order);
+	free(rank);
+
+	qsort(s->records, s->records_no, sizeof *s->records, compare_records);
+
+	for (r = w = 0; r < s->records_no; ++r) {
+		if (w > 0 && compare_records(&s->records[w - 1],
+					     &s->records[r]) == 0
+		    && s->records[w - 1].fields_no == s->records[r].fields_no)
+			continue;
+
+		s->records[w++] = s->records[r];
+	}
+	s->records_no = w;
+
+	for (i = 0; i < s->commits_no; ++i)
+		s->commits[i].records_no = 0;
+
+	for (r = s->records_no; r > 0; --r) {
+		s->commits[s->records[r - 1].commit].first_record = r - 1;
+		++s->commits[s->records[r - 1].commit].records_no;
+	}
+}
+
+static const struct metric *
+get_metric(const char *series)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof metrics / sizeof *metrics; ++i)
+		if (fnmatch(metrics[i].pattern, series, 0) == 0)
+			return &metrics[i];
+
+	/* the last pattern matches everything */
+	assert(0 && "Unreachable");
+	return NULL;
+}
+
+/* value of record that is compared, NAN when there's none */
+static double
+record_value(const struct store_record *r, int field)
+{
+	if (field == 0)
+		return r->fields_no >= 2 ? r->fields[0] + r->fields[1] * 1e-9
+					 : NAN;
+
+	return field <= (int) r->fields_no ? r->fields[field - 1] : NAN;
+}
+
+static int
+series_field(const char *series)
+{
+	return opt_field >= 0 ? opt_field : get_metric(series)->field;
+}
+
+static int
+series_higher_better(const char *series)
+{
+	return opt_field >= 0 ? opt_higher_better
+			      : get_metric(series)->higher_better;
+}
+
+static int
+series_selected(const char *series, char **patterns, int patterns_no)
+{
+	int i;
+
+	if (patterns_no == 0)
+		return 1;
+
+	for (i = 0; i < patterns_no; ++i)
+		if (fnmatch(patterns[i], series, 0) == 0)
+			return 1;
+
+	return 0;
+}
+
+/* summary of values of series in commits [from, to) */
+struct summary {
+	size_t n;
+	double mean;
+	double var;
+};
+
+static void
+summarize(const struct store *s, uint32_t series, uint32_t from,
+	  uint32_t to, struct summary *sum)
+{
+	const struct store_record *r;
+	double v, sq = 0, total = 0;
+	int field = series_field(s->series[series].name);
+	uint32_t c;
+	uint64_t i;
+	int pass;
+
+	memset(sum, 0, sizeof *sum);
+
+	/* the first pass computes mean, the second one variance */
+	for (pass = 0; pass < 2; ++pass) {
+		for (c = from; c < to; ++c) {
+			r = &s->records[s->commits[c].first_record];
+			for (i = 0; i < s->commits[c].records_no; ++i, ++r) {
+				if (r->series != series)
+					continue;
+
+				v = record_value(r, field);
+				if (isnan(v))
+					continue;
+
+				if (pass == 0) {
+					total += v;
+					++sum->n;
+				} else {
+					sq += (v - sum->mean) * (v - sum->mean);
+				}
+			}
+		}
+
+		if (pass == 0 && sum->n == 0)
+			return;
+		if (pass == 0)
+			sum->mean = total / sum->n;
+	}
+
+	sum->var = sum->n > 1 ? sq / (sum->n - 1) : 0;
+}
+
+static int
+find_commit(const struct store *s, const char *prefix, uint32_t *commit)
+{
+	size_t len = strlen(prefix);
+	int found = 0;
+	uint32_t i;
+
+	for (i = 0; i < s->commits_no; ++i) {
+		if (strncmp(s->commits[i].id, prefix, len) == 0) {
+			*commit = i;
+			++found;
+		}
+	}
+
+	if (found == 0)
+		warnx("Commit '%s' is not in the store", prefix);
+	else if (found > 1)
+		warnx("Commit '%s' is ambiguous", prefix);
+
+	return found == 1 ? 0 : -1;
+}
+
+/* compare series in commits [new_from, new_to) with [base_from, base_to),
+ * returns 1 when there is a regression */
+static int
+compare_series(const struct store *s, uint32_t series,
+	       uint32_t base_from, uint32_t base_to,
+	       uint32_t new_from, uint32_t new_to)
+{
+	const char *name = s->series[series].name;
+	struct summary base, new;
+	struct wit_welch w;
+	double change;
+	int worse, regression;
+
+	summarize(s, series, base_from, base_to, &base);
+	summarize(s, series, new_from, new_to, &new);
+
+	/* the series is not measured in one of them */
+	if (base.n == 0 || new.n == 0)
+		return 0;
+
+	if (wit_welch_test(&w, base.mean, base.var, base.n,
+			   new.mean, new.var, new.n) < 0) {
+		printf("  %-40s not enough samples (%zu and %zu)\n",
+		       name, base.n, new.n);
+		return 0;
+	}
+
+	change = base.mean != 0 ? (new.mean - base.mean) / fabs(base.mean)
+				: 0;
+	worse = series_higher_better(name) ? change < 0 : change > 0;
+	regression = worse && w.p < opt_alpha && fabs(change) >= opt_ratio;
+
+	printf("%s %-40s %12.6g -> %12.6g %s %+7.2f%% p=%.4f%s\n",
+	       regression ? "!" : " ", name, base.mean, new.mean,
+	       opt_field >= 0 ? "" : get_metric(name)->unit, change * 100,
+	       w.p, regression ? " REGRESSION"
+			       : w.p < opt_alpha && fabs(change) >= opt_ratio
+				       ? " improvement" : "");
+
+	return regression;
+}
+
+static int
+cmd_compact(int argc, char *argv[])
+{
+	struct store s;
+	int opt, truncate_files = 0, i, added;
+
+	while ((opt = getopt(argc, argv, "t")) != -1) {
+		if (opt != 't')
+			usage(argv[0], EXIT_ERROR);
+		truncate_files = 1;
+	}
+
+	if (argc - optind < 2)
+		usage(argv[0], EXIT_ERROR);
+
+	if (store_load(&s, argv[optind]) < 0)
+		err(EXIT_ERROR, "Loading %s failed", argv[optind]);
+
+	for (i = optind + 1; i < argc; ++i) {
+		added = store_add_history(&s, argv[i]);
+		if (added < 0)
+			err(EXIT_ERROR, "Reading %s failed", argv[i]);
+	}
+
+	store_reindex(&s);
+
+	if (store_save(&s, argv[optind]) < 0)
+		err(EXIT_ERROR, "Saving %s failed", argv[optind]);
+
+	printf("%s: %u benchmarks, %u commits, %" PRIu64 " records\n",
+	       argv[optind], s.series_no, s.commits_no, s.records_no);
+
+	/* histories are in the store now */
+	for (i = optind + 1; truncate_files && i < argc; ++i)
+		if (truncate(argv[i], 0) < 0)
+			warn("Truncating %s failed", argv[i]);
+
+	store_free(&s);
+	return EXIT_SUCCESS;
+}
+
+static int
+cmd_trend(int argc, char *argv[])
+{
+	struct store s;
+	struct summary sum;
+	uint32_t series, c, from, points;
+	double x, sx, sy, sxx, sxy, slope, mean;
+	int opt, last = 10;
+
+	while ((opt = getopt(argc, argv, "n:f:")) != -1) {
+		switch (opt) {
+		case 'n':
+			last = atoi(optarg);
+			break;
+		case 'f':
+			opt_field = atoi(optarg);
+			break;
+		default:
+			usage(argv[0], EXIT_ERROR);
+		}
+	}
+
+	if (argc - optind < 1 || last < 1)
+		usage(argv[0], EXIT_ERROR);
+
+	if (store_load(&s, argv[optind]) < 0)
+		err(EXIT_ERROR, "Loading %s failed", argv[optind]);
+
+	from = s.commits_no > (uint32_t) last ? s.commits_no - last : 0;
+
+	for (series = 0; series < s.series_no; ++series) {
+		if (!series_selected(s.series[series].name, argv + optind + 1,
+				     argc - optind - 1))
+			continue;
+
+		printf("%s [%s]\n", s.series[series].name,
+		       opt_field >= 0 ? "field"
+				      : get_metric(s.series[series].name)->unit);
+
+		/* least squares of means of commits */
+		sx = sy = sxx = sxy = 0;
+		points = 0;
+		for (c = from; c < s.commits_no; ++c) {
+			summarize(&s, series, c, c + 1, &sum);
+			if (sum.n == 0)
+				continue;
+
+			printf("  %.10s %4zu runs %14.6g +- %.3g\n",
+			       s.commits[c].id, sum.n, sum.mean, sqrt(sum.var));
+
+			x = c - from;
+			sx += x;
+			sy += sum.mean;
+			sxx += x * x;
+			sxy += x * sum.mean;
+			++points;
+		}
+
+		if (points < 2)
+			continue;
+
+		mean = sy / points;
+		slope = (points * sxy - sx * sy) / (points * sxx - sx * sx);
+		printf("  trend %+.2f%% per commit\n",
+		       mean != 0 ? slope / fabs(mean) * 100 : 0);
+	}
+
+	store_free(&s);
+	return EXIT_SUCCESS;
+}
+
+static void
+parse_compare_option(int opt, const char *name)
+{
+	switch (opt) {
+	case 'a':
+		opt_alpha = atof(optarg);
+		break;
+	case 'r':
+		opt_ratio = atof(optarg);
+		break;
+	case 'f':
+		opt_field = atoi(optarg);
+		break;
+	case 'H':
+		opt_higher_better = 1;
+		break;
+	default:
+		usage(name, EXIT_ERROR);
+	}
+}
+
+static int
+cmd_compare(int argc, char *argv[])
+{
+	struct store s;
+	uint32_t base, new, series;
+	int opt, regressions = 0;
+
+	while ((opt = getopt(argc, argv, "a:r:f:H")) != -1)
+		parse_compare_option(opt, argv[0]);
+
+	if (argc - optind < 3)
+		usage(argv[0], EXIT_ERROR);
+
+	if (store_load(&s, argv[optind]) < 0)
+		err(EXIT_ERROR, "Loading %s failed", argv[optind]);
+
+	if (find_commit(&s, argv[optind + 1], &base) < 0
+	    || find_commit(&s, argv[optind + 2], &new) < 0) {
+		store_free(&s);
+		return EXIT_ERROR;
+	}
+
+	printf("Comparing %.10s with %.10s\n", s.commits[new].id,
+	       s.commits[base].id);
+
+	for (series = 0; series < s.series_no; ++series)
+		if (series_selected(s.series[series].name, argv + optind + 3,
+				    argc - optind - 3))
+			regressions += compare_series(&s, series, base,
+						      base + 1, new, new + 1);
+
+	store_free(&s);
+
+	printf("%d regressions\n", regressions);
+	return regressions ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
+
+static int
+cmd_check(int argc, char *argv[])
+{
+	struct store s;
+	uint32_t new, from, series;
+	int opt, window = 5, regressions = 0;
+
+	while ((opt = getopt(argc, argv, "w:a:r:f:H")) != -1) {
+		if (opt == 'w')
+			window = atoi(optarg);
+		else
+			parse_compare_option(opt, argv[0]);
+	}
+
+	if (argc - optind < 1 || window < 1)
+		usage(argv[0], EXIT_ERROR);
+
+	if (store_load(&s, argv[optind]) < 0)
+		err(EXIT_ERROR, "Loading %s failed", argv[optind]);
+
+	if (s.commits_no < 2) {
+		printf("Nothing to compare with\n");
+		store_free(&s);
+		return EXIT_SUCCESS;
+	}
+
+	new = s.commits_no - 1;
+	from = new > (uint32_t) window ? new - window : 0;
+
+	printf("Comparing %.10s with %u previous commits\n",
+	       s.commits[new].id, new - from);
+
+	for (series = 0; series < s.series_no; ++series)
+		if (series_selected(s.series[series].name, argv + optind + 1,
+				    argc - optind - 1))
+			regressions += compare_series(&s, series, from, new,
+						      new, new + 1);
+
+	store_free(&s);
+
+	printf("%d regressions\n", regressions);
+	return regressions ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *cmd;
+
+	if (argc < 2)
+		usage(argv[0], EXIT_ERROR);
+
+	cmd = argv[1];
+	if (strcmp(cmd, "--help") == 0 || strcmp(cmd, "-h") == 0)
+		usage(argv[0], EXIT_SUCCESS);
+
+	/* commands parse their options as if they were the program */
+	argv[1] = argv[0];
+	--argc;
+	++argv;
+
+	if (strcmp(cmd, "compact") == 0)
+		return cmd_compact(argc, argv);
+	if (strcmp(cmd, "trend") == 0)
+		return cmd_trend(argc, argv);
+	if (strcmp(cmd, "compare") == 0)
+		return cmd_compare(argc, argv);
+	if (strcmp(cmd, "check") == 0)
+		return cmd_check(argc, argv);
+
+	usage(argv[0], EXIT_ERROR);
+	return EXIT_ERROR;
+}